@@ -3,6 +3,9 @@
 
 #include <QPluginLoader>
 #include <QFileInfo>
+#include <QFile>
+
+#include <string.h>
 
 #include "FormatPlugin.h"
 
@@ -15,6 +18,45 @@ namespace Audio {
 
 
 
+// format names as declared by plugins
+static const QString kWaveFormatName = QLatin1String( "Wave" );
+static const QString kAuFormatName = QLatin1String( "Au" );
+static const QString kFlacFormatName = QLatin1String( "FLAC" );
+static const QString kVorbisFormatName = QLatin1String( "Ogg/Vorbis" );
+static const QString kMp3FormatName = QLatin1String( "Mp3" );
+
+// enough to cover the first Ogg page and common ID3v2 tags without pictures
+static const qint64 kProbeSize = 4*1024;
+
+static const int kId3v2HeaderSize = 10;
+
+
+
+
+inline static bool _hasSignature( const QByteArray & header, const int offset, const char * const signature, const int size )
+{
+	return header.size() >= offset + size && memcmp( header.constData() + offset, signature, size ) == 0;
+}
+
+
+// MPEG audio frame header: 11 bits of frame sync, valid layer, bitrate and sample rate indexes
+inline static bool _hasMpegFrameSync( const QByteArray & header, const int offset )
+{
+	if ( header.size() < offset + 4 )
+		return false;
+
+	const uchar * const bytes = reinterpret_cast<const uchar*>( header.constData() ) + offset;
+
+	return bytes[0] == 0xff && (bytes[1] & 0xe0) == 0xe0 &&
+			((bytes[1] >> 3) & 0x03) != 0x01 &&
+			((bytes[1] >> 1) & 0x03) != 0x00 &&
+			((bytes[2] >> 4) & 0x0f) != 0x0f &&
+			((bytes[2] >> 2) & 0x03) != 0x03;
+}
+
+
+
+
 FormatManager::FormatManager( QObject * const parent ) :
 	QObject( parent )
 {
@@ -34,15 +76,12 @@ FormatManager::FormatManager( QObject * const parent ) :
 
 QStringList FormatManager::availableFileFormats() const
 {
-	QReadLocker fileFormatsLocker( &fileFormatsMutex_ );
 	return availableFileFormats_;
 }
 
 
 QStringList FormatManager::availableFileExtensionsForFormat( const QString & format ) const
 {
-	QReadLocker fileFormatsLocker( &fileFormatsMutex_ );
-
 	Q_ASSERT( audioFormatPluginsForFormat_.contains( format ) );
 
 	QStringList extensions;
@@ -54,23 +93,74 @@ QStringList FormatManager::availableFileExtensionsForFormat( const QString & for
 
 QStringList FormatManager::allAvailableFileExtensions() const
 {
-	QReadLocker fileFormatsLocker( &fileFormatsMutex_ );
 	return allAvailableFileExtensions_;
 }
 
 
+// Guesses format by magic bytes at the beginning of the file, so files with missing or wrong
+// extension are opened by the single matching plugin instead of trying every plugin in turn.
+QString FormatManager::_probeFileFormat( const QString & fileName )
+{
+	QFile file( fileName );
+	if ( !file.open( QIODevice::ReadOnly ) )
+		return QString();
+
+	const QByteArray header = file.read( kProbeSize );
+	file.close();
+
+	if ( _hasSignature( header, 0, "RIFF", 4 ) && _hasSignature( header, 8, "WAVE", 4 ) )
+		return kWaveFormatName;
+
+	if ( _hasSignature( header, 0, ".snd", 4 ) )
+		return kAuFormatName;
+
+	if ( _hasSignature( header, 0, "OggS", 4 ) )
+	{
+		// identification header follows the first page header and its segment table
+		if ( header.indexOf( QByteArray( "\x01vorbis", 7 ) ) != -1 )
+			return kVorbisFormatName;
+		return QString();
+	}
+
+	int offset = 0;
+
+	if ( _hasSignature( header, 0, "ID3", 3 ) )
+	{
+		if ( header.size() < kId3v2HeaderSize )
+			return QString();
+
+		// tag size is stored as syncsafe integer, footer is not counted
+		const uchar * const bytes = reinterpret_cast<const uchar*>( header.constData() );
+		const int tagSize = ((bytes[6] & 0x7f) << 21) | ((bytes[7] & 0x7f) << 14) | ((bytes[8] & 0x7f) << 7) | (bytes[9] & 0x7f);
+		const bool hasFooter = bytes[5] & 0x10;
+
+		offset = kId3v2HeaderSize + tagSize + (hasFooter ? kId3v2HeaderSize : 0);
+
+		// audio data is out of probe range, ID3v2 tag is a strong sign of MPEG audio anyway
+		if ( offset + 4 > header.size() )
+			return kMp3FormatName;
+	}
+
+	if ( _hasSignature( header, offset, "fLaC", 4 ) )
+		return kFlacFormatName;
+
+	if ( _hasMpegFrameSync( header, offset ) )
+		return kMp3FormatName;
+
+	return QString();
+}
+
+
 FormatFile * FormatManager::_createFormatFileFromPlugins( const FormatPluginList & plugins,
 		const FormatPluginList & exceptPlugins,
-		const QString & fileName, const QString & format )
+		const QString & fileName, const QString & format, const FormatFile::OpenFlags openFlags )
 {
-	QWriteLocker fileFormatsLocker( &fileFormatsMutex_ );
-
 	for ( QListIterator<FormatPlugin*> it( plugins ); it.hasNext(); )
 	{
 		FormatPlugin * const plugin = it.next();
 		if ( exceptPlugins.contains( plugin ) )
 			continue;
-		FormatFile * const file = plugin->createFile( fileName, format, FormatFile::OpenFlag_ReadTags );
+		FormatFile * const file = plugin->createFile( fileName, format, openFlags | FormatFile::OpenFlag_ReadTags );
 		Q_ASSERT( file );
 		if ( file->device()->open( QIODevice::ReadOnly ) )
 			return file;
@@ -81,13 +171,14 @@ FormatFile * FormatManager::_createFormatFileFromPlugins( const FormatPluginList
 }
 
 
-FormatFile * FormatManager::createFormatFile( const QString & fileName, const QString & format )
+FormatFile * FormatManager::createFormatFile( const QString & fileName, const QString & format,
+		const FormatFile::OpenFlags openFlags )
 {
 	// lookup plugin by the given format name
 	if ( !format.isNull() )
 	{
 		return _createFormatFileFromPlugins( audioFormatPluginsForFormat_.value( format ),
-				FormatPluginList(), fileName, format );
+				FormatPluginList(), fileName, format, openFlags );
 	}
 
 	// lookup plugin by the file name extension
@@ -101,13 +192,26 @@ FormatFile * FormatManager::createFormatFile( const QString & fileName, const QS
 		// file name has extension
 		extensionPlugins = audioFormatPluginsForExtension_.value( suffix );
 		FormatFile * const file = _createFormatFileFromPlugins( extensionPlugins,
-				FormatPluginList(), fileName, format );
+				FormatPluginList(), fileName, format, openFlags );
 		if ( file )
 			return file;
 	}
 
-	// file name has no extension, try all plugins on by one, except we checked earlier by extension
-	return _createFormatFileFromPlugins( audioFormatPlugins_, extensionPlugins, fileName, format );
+	// file name has no extension or extension does not match contents, look at the contents
+	const QString probedFormat = _probeFileFormat( fileName );
+	if ( !probedFormat.isNull() )
+	{
+		const FormatPluginList probedPlugins = audioFormatPluginsForFormat_.value( probedFormat );
+		FormatFile * const file = _createFormatFileFromPlugins( probedPlugins,
+				extensionPlugins, fileName, format, openFlags );
+		if ( file )
+			return file;
+
+		extensionPlugins << probedPlugins;
+	}
+
+	// contents not recognized, try all plugins on by one, except we checked earlier
+	return _createFormatFileFromPlugins( audioFormatPlugins_, extensionPlugins, fileName, format, openFlags );
 }
 
 
@@ -5,7 +5,8 @@
 #include <QList>
 #include <QStringList>
 #include <QHash>
-#include <QReadWriteLock>
+
+#include "FormatPlugin.h"
 
 
 
@@ -21,12 +22,9 @@ namespace Audio {
 
 
 
-class FormatFile;
-class FormatPlugin;
-
-
-
-
+// Plugins are registered in constructor only and never change afterwards,
+// so all methods may be called from any thread without locking.
+// Plugins themselves guard shared library state, if any.
 class FormatManager : public QObject
 {
 	Q_OBJECT
@@ -38,7 +36,9 @@ public:
 	QStringList availableFileExtensionsForFormat( const QString & format ) const;
 	QStringList allAvailableFileExtensions() const;
 
-	FormatFile * createFormatFile( const QString & fileName, const QString & format );
+	// Files are always opened with FormatFile::OpenFlag_ReadTags, openFlags are added to it.
+	FormatFile * createFormatFile( const QString & fileName, const QString & format,
+			FormatFile::OpenFlags openFlags = FormatFile::OpenFlags() );
 
 	QStringList formatsForExtension( const QString & extension ) const;
 
@@ -46,13 +46,14 @@ private:
 	typedef QList<FormatPlugin*> FormatPluginList;
 
 private:
+	static QString _probeFileFormat( const QString & fileName );
+
 	FormatFile * _createFormatFileFromPlugins( const FormatPluginList & plugins,
 			const FormatPluginList & exceptPlugins,
-			const QString & fileName, const QString & format );
+			const QString & fileName, const QString & format, FormatFile::OpenFlags openFlags );
 	void _addAudioFormatPlugin( FormatPlugin * plugin );
 
 private:
-	mutable QReadWriteLock fileFormatsMutex_;
 	QStringList availableFileFormats_;
 	QStringList allAvailableFileExtensions_;
 	QList<FormatPlugin*> audioFormatPlugins_;
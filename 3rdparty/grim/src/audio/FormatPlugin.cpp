@@ -118,6 +118,29 @@ QMultiMap<QString,QString> FormatFile::tags() const
 }
 
 
+const char * FormatFile::readView( const qint64 maxSize, qint64 & size )
+{
+	Q_UNUSED( maxSize );
+	size = 0;
+	return 0;
+}
+
+
+bool FormatFile::canReadFloat() const
+{
+	return false;
+}
+
+
+qint64 FormatFile::readFloat( float * const * const channels, const qint64 sampleCount )
+{
+	Q_UNUSED( channels );
+	Q_UNUSED( sampleCount );
+	Q_ASSERT( false );
+	return -1;
+}
+
+
 qint64 FormatFile::truncatedSize( qint64 size ) const
 {
 	Q_ASSERT( d_->channels != -1 && d_->frequency != -1 && d_->bitsPerSample != -1 );
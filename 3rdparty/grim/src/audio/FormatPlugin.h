@@ -32,7 +32,12 @@ class GRIM_AUDIO_EXPORT FormatFile
 public:
 	enum OpenFlag
 	{
-		OpenFlag_ReadTags = 0x01
+		OpenFlag_ReadTags  = 0x01,
+
+		// File may be truncated or rewritten by other processes while open.
+		// Such files are never memory mapped, since touching pages past the new end of a mapped file
+		// raises SIGBUS and kills the whole process, they are read as usual instead.
+		OpenFlag_MayChange = 0x02
 	};
 	Q_DECLARE_FLAGS( OpenFlags, OpenFlag )
 
@@ -41,6 +46,20 @@ public:
 
 	virtual QIODevice * device() = 0;
 
+	// Zero copy alternative to device()->read() for formats keeping decoded data in memory as is,
+	// e.g. mapped PCM files. Returns pointer to the next size bytes, valid until the next read, seek or close,
+	// and advances device position.
+	// Returns 0 with size 0 if not supported, device()->read() should be used then.
+	// Returns 0 with size -1 on read error.
+	virtual const char * readView( qint64 maxSize, qint64 & size );
+
+	// Optional planar float output in [-1, 1] range for formats decoded to float natively,
+	// avoids round trip through integer samples. Reads up to sampleCount samples into each
+	// of channels() buffers and advances device position, returns number of samples read,
+	// 0 at the end or -1 on error. Valid only when canReadFloat() returns true for opened file.
+	virtual bool canReadFloat() const;
+	virtual qint64 readFloat( float * const * channels, qint64 sampleCount );
+
 	OpenFlags openFlags() const;
 	QString fileName() const;
 	QString format() const;
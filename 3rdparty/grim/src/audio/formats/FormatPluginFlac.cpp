@@ -105,8 +105,9 @@ FLAC__bool FlacFormatDevice::flac_eof( const FLAC__StreamDecoder * const decoder
 }
 
 
-template<int channelCount, int bytesPerSample>
-static void _processFrameSamples( const FLAC__int32 * const * flacData, char * const rawData, const qint64 sampleCount )
+template<int bytesPerSample>
+static void _processFrameSamples( const FLAC__int32 * const * flacData, char * const rawData, const qint64 sampleCount,
+	const int channelCount )
 {
 	const int channelSampleSize = channelCount * bytesPerSample;
 	for ( int sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex )
@@ -131,30 +132,97 @@ void FlacFormatDevice::_processFrame( const FLAC__int32 * const * flacData, char
 		return;
 	}
 
-	if ( formatFile_->channels() == 1 )
+	const int channelCount = formatFile_->channels();
+
+	switch ( formatFile_->bitsPerSample() )
 	{
-		switch ( formatFile_->bitsPerSample() )
-		{
-		case  8: _processFrameSamples<1,1>( flacData, rawData, sampleCount ); break;
-		case 16: _processFrameSamples<1,2>( flacData, rawData, sampleCount ); break;
-		case 24: _processFrameSamples<1,3>( flacData, rawData, sampleCount ); break;
-		case 32: _processFrameSamples<1,4>( flacData, rawData, sampleCount ); break;
-		default:
-			Q_ASSERT( false );
-		}
+	case  8: _processFrameSamples<1>( flacData, rawData, sampleCount, channelCount ); break;
+	case 16: _processFrameSamples<2>( flacData, rawData, sampleCount, channelCount ); break;
+	case 24: _processFrameSamples<3>( flacData, rawData, sampleCount, channelCount ); break;
+	case 32: _processFrameSamples<4>( flacData, rawData, sampleCount, channelCount ); break;
+	default:
+		Q_ASSERT( false );
 	}
-	else
+}
+
+
+inline static float _floatScale( const int bitsPerSample )
+{
+	return 1.0f / float(qint64(1) << (bitsPerSample - 1));
+}
+
+
+void FlacFormatDevice::_processFrameFloat( const FLAC__int32 * const * const flacData, float * const * const floatData,
+	const qint64 offset, const qint64 sampleCount )
+{
+	const float scale = _floatScale( formatFile_->bitsPerSample() );
+
+	for ( int channelIndex = 0; channelIndex < formatFile_->channels(); ++channelIndex )
 	{
-		switch ( formatFile_->bitsPerSample() )
+		float * const channelData = floatData[ channelIndex ] + offset;
+
+		if ( !flacData )
 		{
-		case  8: _processFrameSamples<2,1>( flacData, rawData, sampleCount ); break;
-		case 16: _processFrameSamples<2,2>( flacData, rawData, sampleCount ); break;
-		case 24: _processFrameSamples<2,3>( flacData, rawData, sampleCount ); break;
-		case 32: _processFrameSamples<2,4>( flacData, rawData, sampleCount ); break;
-		default:
-			Q_ASSERT( false );
+			memset( channelData, 0, sampleCount * sizeof(float) );
+			continue;
 		}
+
+		const FLAC__int32 * const flacChannelData = flacData[ channelIndex ];
+		for ( qint64 sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex )
+			channelData[ sampleIndex ] = float(flacChannelData[ sampleIndex ]) * scale;
+	}
+}
+
+
+void FlacFormatDevice::_allocateCache( const qint64 stride )
+{
+	readCacheStride_ = stride;
+	readCache_ = QVector<FLAC__int32>( int(formatFile_->channels()*readCacheStride_) );
+}
+
+
+// Keeps frame samples that did not fit into read target, planar as decoder produced them.
+// Cache is always drained before the next frame is decoded, so it never wraps around
+// and is allocated once for the stream max block size.
+void FlacFormatDevice::_cacheFrame( const FLAC__int32 * const * const flacData, const qint64 offset, const qint64 sampleCount )
+{
+	const int channelCount = formatFile_->channels();
+
+	if ( sampleCount > readCacheStride_ )
+	{
+		// STREAMINFO lied about block size
+		_allocateCache( sampleCount );
 	}
+
+	for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+		memcpy( readCache_.data() + channelIndex*readCacheStride_, flacData[ channelIndex ] + offset,
+				sampleCount * sizeof(FLAC__int32) );
+
+	readCacheOffset_ = 0;
+	readCacheSize_ = sampleCount;
+}
+
+
+void FlacFormatDevice::_cachedData( const FLAC__int32 ** const cachedData ) const
+{
+	for ( int channelIndex = 0; channelIndex < formatFile_->channels(); ++channelIndex )
+		cachedData[ channelIndex ] = readCache_.constData() + channelIndex*readCacheStride_ + readCacheOffset_;
+}
+
+
+void FlacFormatDevice::_consumeCache( const qint64 sampleCount )
+{
+	Q_ASSERT( sampleCount <= readCacheSize_ );
+
+	readCacheOffset_ += sampleCount;
+	readCacheSize_ -= sampleCount;
+}
+
+
+void FlacFormatDevice::_clearCache()
+{
+	readCacheOffset_ = 0;
+	readCacheSize_ = 0;
 }
 
 
@@ -194,7 +262,11 @@ FLAC__StreamDecoderWriteStatus FlacFormatDevice::flac_write( const FLAC__StreamD
 		samplesToReadToBuffer = qMin<qint64>( readMaxSamples, remainSamples );
 		const qint64 bytesToReadToBuffer = flacDevice->formatFile_->samplesToBytes( samplesToReadToBuffer );
 
-		flacDevice->_processFrame( buffer, flacDevice->readData_, samplesToReadToBuffer );
+		if ( flacDevice->readFloatData_ )
+			flacDevice->_processFrameFloat( buffer, flacDevice->readFloatData_,
+					flacDevice->formatFile_->bytesToSamples( flacDevice->readTotalBytes_ ), samplesToReadToBuffer );
+		else
+			flacDevice->_processFrame( buffer, flacDevice->readData_, samplesToReadToBuffer );
 		flacDevice->readBytes_ = bytesToReadToBuffer;
 	}
 
@@ -202,19 +274,10 @@ FLAC__StreamDecoderWriteStatus FlacFormatDevice::flac_write( const FLAC__StreamD
 	remainSamples -= samplesToReadToBuffer;
 
 	// at this point cache is always cleared either from read or seek
-	Q_ASSERT( flacDevice->readCache_.isEmpty() );
+	Q_ASSERT( flacDevice->readCacheSize_ == 0 );
 
 	if ( remainSamples > 0 )
-	{
-		flacDevice->readCache_.resize( flacDevice->formatFile_->samplesToBytes( remainSamples ) );
-
-		// create temporary buffer with shifted sample offsets
-		const FLAC__int32 * shiftedBuffer[ 2 ]; // 2 == maximum number of channels, this value is checked in open()
-		for ( int i = 0; i < flacDevice->formatFile_->channels(); ++i )
-			shiftedBuffer[ i ] = buffer[ i ] + samplesToReadToBuffer;
-
-		flacDevice->_processFrame( shiftedBuffer, flacDevice->readCache_.data(), remainSamples );
-	}
+		flacDevice->_cacheFrame( buffer, samplesToReadToBuffer, remainSamples );
 
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
@@ -231,8 +294,8 @@ void FlacFormatDevice::flac_metadata( const FLAC__StreamDecoder * const decoder,
 	{
 		const FLAC__StreamMetadata_StreamInfo & streamInfo = metadata->data.stream_info;
 
-		// can process only mono or stereo
-		if ( streamInfo.channels != 1 && streamInfo.channels != 2 )
+		// channels are left in FLAC order, which is the same as WAVE one
+		if ( streamInfo.channels < 1 || streamInfo.channels > FLAC__MAX_CHANNELS )
 			return;
 
 		// can process only 8 or 16 bits per sample
@@ -254,6 +317,7 @@ void FlacFormatDevice::flac_metadata( const FLAC__StreamDecoder * const decoder,
 		flacDevice->formatFile_->setFrequency( streamInfo.sample_rate );
 		flacDevice->formatFile_->setBitsPerSample( streamInfo.bits_per_sample );
 		flacDevice->formatFile_->setTotalSamples( streamInfo.total_samples );
+		flacDevice->maxBlockSize_ = streamInfo.max_blocksize;
 
 		flacDevice->isStreamMetadataProcessed_ = true;
 	}
@@ -337,6 +401,11 @@ FlacFormatDevice::FlacFormatDevice( FlacFormatFile * const formatFile ) :
 	flacDecoder_ = 0;
 	pos_ = -1;
 	isSeeking_ = false;
+	readData_ = 0;
+	readFloatData_ = 0;
+	readCacheStride_ = 0;
+	readCacheOffset_ = 0;
+	readCacheSize_ = 0;
 }
 
 
@@ -468,6 +537,7 @@ bool FlacFormatDevice::_open( const QString & format, const bool firstTime )
 	}
 
 	isStreamMetadataProcessed_ = false;
+	maxBlockSize_ = 0;
 
 	const bool isProcessed = FLAC__stream_decoder_process_until_end_of_metadata( flacDecoder_ );
 	if ( !isProcessed )
@@ -500,6 +570,9 @@ bool FlacFormatDevice::_open( const QString & format, const bool firstTime )
 		}
 	}
 
+	if ( readCacheStride_ != maxBlockSize_ )
+		_allocateCache( maxBlockSize_ );
+
 	outputSize_ = formatFile_->samplesToBytes( formatFile_->totalSamples() );
 	pos_ = 0;
 
@@ -559,7 +632,7 @@ void FlacFormatDevice::_close()
 	FLAC__stream_decoder_delete( flacDecoder_ );
 	flacDecoder_ = 0;
 
-	readCache_ = QByteArray();
+	_clearCache();
 
 	pos_ = -1;
 }
@@ -574,6 +647,9 @@ void FlacFormatDevice::close()
 
 	_close();
 
+	readCache_ = QVector<FLAC__int32>();
+	readCacheStride_ = 0;
+
 	file_.close();
 }
 
@@ -629,6 +705,7 @@ qint64 FlacFormatDevice::readData( char * data, qint64 maxSize )
 	readTotalBytes_ = 0;
 
 	readData_ = data;
+	readFloatData_ = 0;
 
 #ifdef GRIM_AUDIO_FORMAT_FLAC_STRICT_OUTPUT_SIZE
 	readMaxSize_ = qMin( formatFile_->truncatedSize( maxSize ), outputSize_ - pos_ );
@@ -640,29 +717,76 @@ qint64 FlacFormatDevice::readData( char * data, qint64 maxSize )
 		return readTotalBytes_;
 
 	// first fill data with samples from cache
-	if ( !readCache_.isEmpty() )
+	if ( readCacheSize_ > 0 )
 	{
-		const qint64 bytesToCopy = qMin<qint64>( readCache_.size(), readMaxSize_ );
+		const qint64 samplesToCopy = qMin( readCacheSize_, formatFile_->bytesToSamples( readMaxSize_ ) );
+		const qint64 bytesToCopy = formatFile_->samplesToBytes( samplesToCopy );
 
-		memcpy( readData_, readCache_.constData(), bytesToCopy );
-		readCache_ = readCache_.mid( bytesToCopy );
+		const FLAC__int32 * cachedData[ FLAC__MAX_CHANNELS ];
+		_cachedData( cachedData );
+		_processFrame( cachedData, readData_, samplesToCopy );
+		_consumeCache( samplesToCopy );
 
 		readData_ += bytesToCopy;
 		readMaxSize_ -= bytesToCopy;
 		readTotalBytes_ += bytesToCopy;
 	}
 
-	if ( readMaxSize_ == 0 )
-	{
+	return _readFrames();
+}
+
+
+// Same as readData() but decoded samples are converted to float straight from decoder buffers.
+qint64 FlacFormatDevice::readFloat( float * const * const channels, const qint64 sampleCount )
+{
+	Q_ASSERT( isOpen() );
+
+	isSeeking_ = false;
+
+	readTotalBytes_ = 0;
+
+	readData_ = 0;
+	readFloatData_ = channels;
+
 #ifdef GRIM_AUDIO_FORMAT_FLAC_STRICT_OUTPUT_SIZE
-		if ( pos_ + readTotalBytes_ == outputSize_ )
-		{
-			Q_ASSERT( readCache_.isEmpty() );
-		}
+	readMaxSize_ = qMin( formatFile_->samplesToBytes( sampleCount ), outputSize_ - pos_ );
+#else
+	readMaxSize_ = formatFile_->samplesToBytes( sampleCount );
 #endif
-		return readTotalBytes_;
+
+	if ( readMaxSize_ == 0 )
+		return 0;
+
+	if ( readCacheSize_ > 0 )
+	{
+		const qint64 samplesToCopy = qMin( readCacheSize_, formatFile_->bytesToSamples( readMaxSize_ ) );
+		const qint64 bytesToCopy = formatFile_->samplesToBytes( samplesToCopy );
+
+		const FLAC__int32 * cachedData[ FLAC__MAX_CHANNELS ];
+		_cachedData( cachedData );
+		_processFrameFloat( cachedData, channels, 0, samplesToCopy );
+		_consumeCache( samplesToCopy );
+
+		readMaxSize_ -= bytesToCopy;
+		readTotalBytes_ += bytesToCopy;
 	}
 
+	const qint64 bytesRead = _readFrames();
+	readFloatData_ = 0;
+
+	if ( bytesRead == -1 )
+		return -1;
+
+	// samples bypass QIODevice::read(), keep its position in sync
+	QIODevice::seek( pos_ );
+
+	return formatFile_->bytesToSamples( bytesRead );
+}
+
+
+// Decodes frames until readMaxSize_ bytes are written into read target, returns total bytes read.
+qint64 FlacFormatDevice::_readFrames()
+{
 	// load rest bytes from decoder
 	while ( readMaxSize_ > 0 )
 	{
@@ -670,7 +794,7 @@ qint64 FlacFormatDevice::readData( char * data, qint64 maxSize )
 
 		if ( !FLAC__stream_decoder_process_single( flacDecoder_ ) )
 		{
-			readCache_ = QByteArray();
+			_clearCache();
 			return -1;
 		}
 
@@ -682,11 +806,19 @@ qint64 FlacFormatDevice::readData( char * data, qint64 maxSize )
 			break;
 		}
 
-		readData_ += readBytes_;
+		if ( readData_ )
+			readData_ += readBytes_;
 		readMaxSize_ -= readBytes_;
 		readTotalBytes_ += readBytes_;
 	}
 
+#ifdef GRIM_AUDIO_FORMAT_FLAC_STRICT_OUTPUT_SIZE
+	if ( pos_ + readTotalBytes_ == outputSize_ )
+	{
+		Q_ASSERT( readCacheSize_ == 0 );
+	}
+#endif
+
 	pos_ += readTotalBytes_;
 
 #ifndef GRIM_AUDIO_FORMAT_FLAC_STRICT_OUTPUT_SIZE
@@ -755,7 +887,7 @@ bool FlacFormatDevice::seek( const qint64 pos )
 	Q_ASSERT( !isSequential_ );
 
 	readTotalBytes_ = 0;
-	readCache_ = QByteArray();
+	_clearCache();
 
 	// this also asserts correct pos value
 	seekSample_ = formatFile_->bytesToSamples( pos );
@@ -789,6 +921,18 @@ QIODevice * FlacFormatFile::device()
 }
 
 
+bool FlacFormatFile::canReadFloat() const
+{
+	return true;
+}
+
+
+qint64 FlacFormatFile::readFloat( float * const * const channels, const qint64 sampleCount )
+{
+	return device_.readFloat( channels, sampleCount );
+}
+
+
 
 
 QStringList FlacFormatPlugin::formats() const
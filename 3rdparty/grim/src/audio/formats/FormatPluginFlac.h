@@ -5,6 +5,7 @@
 
 #include <QIODevice>
 #include <QFile>
+#include <QVector>
 #include <QDebug>
 
 #include <FLAC/stream_decoder.h>
@@ -71,11 +72,22 @@ public:
 
 	bool seek( qint64 pos );
 
+	qint64 readFloat( float * const * channels, qint64 sampleCount );
+
 private:
 	bool _open( const QString & format, bool firstTime );
 	void _close();
 
 	void _processFrame( const FLAC__int32 * const * flacData, char * rawData, qint64 sampleCount );
+	void _processFrameFloat( const FLAC__int32 * const * flacData, float * const * floatData, qint64 offset, qint64 sampleCount );
+
+	void _allocateCache( qint64 stride );
+	void _cacheFrame( const FLAC__int32 * const * flacData, qint64 offset, qint64 sampleCount );
+	void _cachedData( const FLAC__int32 ** cachedData ) const;
+	void _consumeCache( qint64 sampleCount );
+	void _clearCache();
+
+	qint64 _readFrames();
 
 	bool _readTags();
 
@@ -93,14 +105,19 @@ private:
 
 	// for metadata callback
 	bool isStreamMetadataProcessed_;
+	qint64 maxBlockSize_;
 
 	// for write callback
 	bool isSeeking_;          // indicates whether we are inside seek or read
 
 	char * readData_;         // input data pointer
+	float * const * readFloatData_; // planar output when reading float, 0 otherwise
 	qint64 readMaxSize_;      // input data max size
 	qint64 readBytes_;      // output bytes count
-	QByteArray readCache_;    // cache between readData() calls to store unhandled samples
+	QVector<FLAC__int32> readCache_; // planar samples of the last frame not consumed by read calls yet
+	qint64 readCacheStride_;  // samples per channel in cache, max block size of the stream
+	qint64 readCacheOffset_;  // first unconsumed sample in cache
+	qint64 readCacheSize_;    // unconsumed samples in cache
 	qint64 readTotalBytes_; // total bytes readed so far at current readData() call
 
 	qint64 seekSample_;       // sample that was passed to seek
@@ -118,6 +135,9 @@ public:
 
 	QIODevice * device();
 
+	bool canReadFloat() const;
+	qint64 readFloat( float * const * channels, qint64 sampleCount );
+
 private:
 	FlacFormatDevice device_;
 
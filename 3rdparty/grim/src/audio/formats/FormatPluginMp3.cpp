@@ -16,6 +16,14 @@ static const QByteArray kMp3FormatName = "Mp3";
 
 static const char kCodecForRawStringsKey[] = "GRIM_AUDIO_MP3_FORMAT_PLUGIN_CODEC_FOR_RAW_STRINGS";
 
+// files are opened on several threads at once, keep tag keys out of function local statics
+static const QString kTitleTagKey       = QLatin1String( "TITLE" );
+static const QString kArtistTagKey      = QLatin1String( "ARTIST" );
+static const QString kAlbumTagKey       = QLatin1String( "ALBUM" );
+static const QString kGenreTagKey       = QLatin1String( "GENRE" );
+static const QString kTrackNumberTagKey = QLatin1String( "TRACKNUMBER" );
+static const QString kDateTagKey        = QLatin1String( "DATE" );
+
 QReadWriteLock Mp3FormatMpg123Singlethon::sLock;
 QAtomicInt Mp3FormatMpg123Singlethon::sRef;
 bool Mp3FormatMpg123Singlethon::sIsValid = false;
@@ -112,6 +120,7 @@ Mp3FormatDevice::Mp3FormatDevice( Mp3FormatFile * const formatFile ) :
 	codecForRawStrings_ = QTextCodec::codecForName( qgetenv( kCodecForRawStringsKey ) );
 
 	pos_ = -1;
+	isFloatOutput_ = false;
 }
 
 
@@ -121,6 +130,45 @@ Mp3FormatDevice::~Mp3FormatDevice()
 }
 
 
+// mpg123 synthesizes float internally, asking for float output keeps full decoder precision.
+// Integer only builds of mpg123 do not provide float encoding, 16-bit output is used then.
+bool Mp3FormatDevice::_setFloatOutputFormats()
+{
+	const int * encodings;
+	size_t encodingCount;
+	mpg123_encodings( &encodings, &encodingCount );
+
+	bool hasFloatEncoding = false;
+	for ( size_t i = 0; i < encodingCount; ++i )
+	{
+		if ( encodings[ i ] == MPG123_ENC_FLOAT_32 )
+		{
+			hasFloatEncoding = true;
+			break;
+		}
+	}
+
+	if ( !hasFloatEncoding )
+		return false;
+
+	const long * rates;
+	size_t rateCount;
+	mpg123_rates( &rates, &rateCount );
+
+	mpg123_format_none( mpgHandle_ );
+	for ( size_t i = 0; i < rateCount; ++i )
+	{
+		if ( mpg123_format( mpgHandle_, rates[ i ], MPG123_MONO | MPG123_STEREO, MPG123_ENC_FLOAT_32 ) != MPG123_OK )
+		{
+			mpg123_format_all( mpgHandle_ );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
 bool Mp3FormatDevice::_open( const QString & format, const bool firstTime )
 {
 	// only MP3 format is supported by this plugin
@@ -158,6 +206,8 @@ bool Mp3FormatDevice::_open( const QString & format, const bool firstTime )
 	//const int callbacksErrorCode = mpg123_replace_reader( mpgHandle_, mpg_read_descriptor, mpg_seek_descriptor );
 	Q_ASSERT( callbacksErrorCode == MPG123_OK );
 
+	isFloatOutput_ = _setFloatOutputFormats();
+
 	const int openErrorCode = mpg123_open_handle( mpgHandle_, this );
 	//const int openErrorCode = mpg123_open( mpgHandle_, "/home/dendy/tmp/music_mp3/Amorphis/01 - Disment Of Soul (1990)/01 - Disment Of Soul.mp3" );
 	//const int openErrorCode = mpg123_open_fd( mpgHandle_, generateDescriptorFordevice( this ) );
@@ -180,9 +230,9 @@ bool Mp3FormatDevice::_open( const QString & format, const bool firstTime )
 		return false;
 	}
 
-	if ( encoding != MPG123_ENC_SIGNED_16 )
+	if ( encoding != (isFloatOutput_ ? MPG123_ENC_FLOAT_32 : MPG123_ENC_SIGNED_16) )
 	{
-		mp3FormatDebug() << "Encoding is not MPG123_ENC_SIGNED_16";
+		mp3FormatDebug() << "Unexpected encoding:" << encoding;
 		mpg123_close( mpgHandle_ );
 		mpg123_delete( mpgHandle_ );
 		return false;
@@ -285,13 +335,6 @@ QString Mp3FormatDevice::_fromRawString( const char * string, int size ) const
 
 void Mp3FormatDevice::_readId3Tags( QMultiMap<QString,QString> & tags )
 {
-	static const QString kTitleTagKey       = QLatin1String( "TITLE" );
-	static const QString kArtistTagKey      = QLatin1String( "ARTIST" );
-	static const QString kAlbumTagKey       = QLatin1String( "ALBUM" );
-	static const QString kGenreTagKey       = QLatin1String( "GENRE" );
-	static const QString kTrackNumberTagKey = QLatin1String( "TRACKNUMBER" );
-	static const QString kDateTagKey        = QLatin1String( "DATE" );
-
 	//mpg123_scan( mpgHandle_ );
 
 	mpg123_id3v1 * id3v1 = 0;
@@ -447,6 +490,41 @@ qint64 Mp3FormatDevice::bytesAvailable() const
 }
 
 
+static void _convertFloatToInt16( const float * const floatData, qint16 * const intData, const qint64 count )
+{
+	for ( qint64 i = 0; i < count; ++i )
+		intData[ i ] = qint16(qRound( qBound( -32768.0f, floatData[ i ]*32768.0f, 32767.0f ) ));
+}
+
+
+// Reads up to maxSize bytes of decoder output, returns mpg123 error code.
+int Mp3FormatDevice::_read( char * const data, const qint64 maxSize, qint64 & bytesRead )
+{
+	const qint64 bytesToRead = qMin( bufferSize_, maxSize );
+
+	size_t decodedBytes;
+	const int readErrorCode = mpg123_read( mpgHandle_, reinterpret_cast<unsigned char*>( data ), bytesToRead, &decodedBytes );
+
+	if ( readErrorCode != MPG123_OK && readErrorCode != MPG123_DONE )
+	{
+		mp3FormatDebug() << "mpg123_read() error:" << readErrorCode << mpg123_plain_strerror( readErrorCode );
+
+		if ( readErrorCode == MPG123_NEED_MORE )
+		{
+			// mpg123 wants more, but file already at end, probably file is truncated
+			// ignore this error, return what is read so far and close the file
+		}
+		else
+		{
+			return readErrorCode;
+		}
+	}
+
+	bytesRead = decodedBytes;
+	return readErrorCode;
+}
+
+
 qint64 Mp3FormatDevice::readData( char * const data, const qint64 maxSize )
 {
 	Q_ASSERT( isOpen() );
@@ -459,32 +537,29 @@ qint64 Mp3FormatDevice::readData( char * const data, const qint64 maxSize )
 
 	while ( bytesRemain > 0 )
 	{
-		const qint64 bytesToRead = qMin( bufferSize_, bytesRemain );
+		qint64 bytesRead;
+		int readErrorCode;
 
-		size_t bytesRead;
-		const int readErrorCode = mpg123_read( mpgHandle_, reinterpret_cast<unsigned char*>( currentData ), bytesToRead, &bytesRead );
-
-		if ( readErrorCode != MPG123_OK && readErrorCode != MPG123_DONE )
+		if ( isFloatOutput_ )
 		{
-			mp3FormatDebug() << "mpg123_read() error:" << readErrorCode << mpg123_plain_strerror( readErrorCode );
-
-			if ( readErrorCode == MPG123_NEED_MORE )
-			{
-				// mpg123 wants more, but file already at end, probably file is truncated
-				// ignore this error, return what is read so far and close the file
-			}
-			else
+			// decode float samples aside and narrow them to 16-bit
+			floatBuffer_.resize( int(qMin( bufferSize_, bytesRemain*2 )) );
+			readErrorCode = _read( floatBuffer_.data(), floatBuffer_.size(), bytesRead );
+			if ( readErrorCode == MPG123_OK || readErrorCode == MPG123_DONE || readErrorCode == MPG123_NEED_MORE )
 			{
-				return -1;
+				_convertFloatToInt16( reinterpret_cast<const float*>( floatBuffer_.constData() ),
+						reinterpret_cast<qint16*>( currentData ), bytesRead/sizeof(float) );
+				bytesRead /= 2;
 			}
 		}
-
-		if ( bytesRead < 0 )
+		else
 		{
-			mp3FormatDebug() << "Read bytes < 0";
-			return -1;
+			readErrorCode = _read( currentData, bytesRemain, bytesRead );
 		}
 
+		if ( readErrorCode != MPG123_OK && readErrorCode != MPG123_DONE && readErrorCode != MPG123_NEED_MORE )
+			return -1;
+
 		pos_ += bytesRead;
 		bytesRemain -= bytesRead;
 		currentData += bytesRead;
@@ -501,6 +576,54 @@ qint64 Mp3FormatDevice::readData( char * const data, const qint64 maxSize )
 }
 
 
+// Deinterleaves float decoder output, available only when isFloatOutput() is true.
+qint64 Mp3FormatDevice::readFloat( float * const * const channels, const qint64 sampleCount )
+{
+	Q_ASSERT( isOpen() );
+	Q_ASSERT( isFloatOutput_ );
+
+	if ( atEnd_ )
+		return 0;
+
+	const int channelCount = formatFile_->channels();
+	const qint64 floatSampleSize = channelCount * sizeof(float);
+
+	qint64 totalSamples = 0;
+
+	while ( totalSamples < sampleCount )
+	{
+		floatBuffer_.resize( int(qMin( bufferSize_, (sampleCount - totalSamples)*floatSampleSize )) );
+
+		qint64 bytesRead;
+		const int readErrorCode = _read( floatBuffer_.data(), floatBuffer_.size(), bytesRead );
+		if ( readErrorCode != MPG123_OK && readErrorCode != MPG123_DONE && readErrorCode != MPG123_NEED_MORE )
+			return -1;
+
+		const float * const floatData = reinterpret_cast<const float*>( floatBuffer_.constData() );
+		const qint64 samplesRead = bytesRead / floatSampleSize;
+		for ( qint64 sampleIndex = 0; sampleIndex < samplesRead; ++sampleIndex )
+			for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+				channels[ channelIndex ][ totalSamples + sampleIndex ] = floatData[ sampleIndex*channelCount + channelIndex ];
+
+		totalSamples += samplesRead;
+		pos_ += formatFile_->samplesToBytes( samplesRead );
+
+		if ( readErrorCode == MPG123_DONE || readErrorCode == MPG123_NEED_MORE )
+		{
+			atEnd_ = true;
+			outputSize_ = pos_;
+			break;
+		}
+	}
+
+	// samples bypass QIODevice::read(), keep its position in sync
+	if ( !isSequential_ )
+		QIODevice::seek( pos_ );
+
+	return totalSamples;
+}
+
+
 qint64 Mp3FormatDevice::writeData( const char * const data, const qint64 maxSize )
 {
 	Q_UNUSED( data );
@@ -586,6 +709,18 @@ QIODevice * Mp3FormatFile::device()
 }
 
 
+bool Mp3FormatFile::canReadFloat() const
+{
+	return device_.isFloatOutput();
+}
+
+
+qint64 Mp3FormatFile::readFloat( float * const * const channels, const qint64 sampleCount )
+{
+	return device_.readFloat( channels, sampleCount );
+}
+
+
 
 
 QStringList Mp3FormatPlugin::formats() const
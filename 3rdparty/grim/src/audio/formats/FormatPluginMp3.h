@@ -79,10 +79,16 @@ public:
 
 	bool seek( qint64 pos );
 
+	bool isFloatOutput() const;
+	qint64 readFloat( float * const * channels, qint64 sampleCount );
+
 private:
 	bool _open( const QString & format, bool firstTime );
 	void _close();
 
+	bool _setFloatOutputFormats();
+	int _read( char * data, qint64 maxSize, qint64 & bytesRead );
+
 	QString _fromMpgString( const mpg123_string * string ) const;
 	QString _fromRawString( const char * string, int size ) const;
 	void _readId3Tags( QMultiMap<QString,QString> & tags );
@@ -101,6 +107,8 @@ private:
 	Mp3FormatMpg123Singlethon mpgSinglethon_;
 	mpg123_handle * mpgHandle_;
 	qint64 bufferSize_;
+	bool isFloatOutput_;      // decoder produces 32-bit float, integer output is converted from it
+	QByteArray floatBuffer_;
 	const QTextCodec * codecForRawStrings_;
 };
 
@@ -114,6 +122,9 @@ public:
 
 	QIODevice * device();
 
+	bool canReadFloat() const;
+	qint64 readFloat( float * const * channels, qint64 sampleCount );
+
 private:
 	Mp3FormatDevice device_;
 
@@ -140,5 +151,11 @@ public:
 
 
 
+inline bool Mp3FormatDevice::isFloatOutput() const
+{ return isFloatOutput_; }
+
+
+
+
 } // namespace Audio
 } // namespace Grim
@@ -3,6 +3,8 @@
 
 #include "VorbisComment.h"
 
+#include <string.h>
+
 
 
 
@@ -479,6 +481,62 @@ bool VorbisFormatDevice::seek( const qint64 pos )
 }
 
 
+// Vorbis is decoded to float natively, this skips conversion to 16-bit integers and back.
+qint64 VorbisFormatDevice::readFloat( float * const * const channels, const qint64 sampleCount )
+{
+	Q_ASSERT( isOpen() );
+
+	if ( isSequential_ && atEnd_ )
+		return 0;
+
+	const int channelCount = formatFile_->channels();
+
+	qint64 remainSamples = isSequential_ ? sampleCount :
+			qMin( sampleCount, formatFile_->bytesToSamples( outputSize_ - pos_ ) );
+	qint64 totalSamples = 0;
+
+	while ( remainSamples > 0 )
+	{
+		float ** pcm;
+		int stream;
+		const long samplesRead = ov_read_float( &oggVorbisFile_, &pcm, int(remainSamples), &stream );
+
+		if ( samplesRead < 0 )
+		{
+			vorbisFormatDebug() << "ov_read_float() error, code =" << samplesRead;
+			return -1;
+		}
+
+		if ( readError_ )
+			return -1;
+
+		if ( samplesRead == 0 )
+		{
+			// end of file reached before the declared length
+			if ( !isSequential_ )
+				return -1;
+
+			atEnd_ = true;
+			break;
+		}
+
+		for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+			memcpy( channels[ channelIndex ] + totalSamples, pcm[ channelIndex ], samplesRead * sizeof(float) );
+
+		totalSamples += samplesRead;
+		remainSamples -= samplesRead;
+	}
+
+	pos_ += formatFile_->samplesToBytes( totalSamples );
+
+	// samples bypass QIODevice::read(), keep its position in sync
+	if ( !isSequential_ )
+		QIODevice::seek( pos_ );
+
+	return totalSamples;
+}
+
+
 VorbisFormatFile::VorbisFormatFile( const QString & fileName, const QString & format,
 	const FormatFile::OpenFlags openFlags ) :
 	FormatFile( fileName, format, openFlags ),
@@ -493,6 +551,18 @@ QIODevice * VorbisFormatFile::device()
 }
 
 
+bool VorbisFormatFile::canReadFloat() const
+{
+	return true;
+}
+
+
+qint64 VorbisFormatFile::readFloat( float * const * const channels, const qint64 sampleCount )
+{
+	return device_.readFloat( channels, sampleCount );
+}
+
+
 
 
 QStringList VorbisFormatPlugin::formats() const
@@ -58,6 +58,8 @@ public:
 
 	bool seek( qint64 pos );
 
+	qint64 readFloat( float * const * channels, qint64 sampleCount );
+
 private:
 	bool _open( const QString & format, bool firstTime );
 	void _close();
@@ -87,6 +89,9 @@ public:
 
 	QIODevice * device();
 
+	bool canReadFloat() const;
+	qint64 readFloat( float * const * channels, qint64 sampleCount );
+
 private:
 	VorbisFormatDevice device_;
 
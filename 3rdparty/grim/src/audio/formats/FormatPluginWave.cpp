@@ -3,6 +3,10 @@
 
 #include <QDataStream>
 
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
 
 
 
@@ -25,6 +29,12 @@ static const quint32 kDataMagic = 0x64617461; // 4 bytes of .wav file: "data"
 static const quint32 kAuMagic   = 0x2E736E64; // first 4 bytes of .au file:  ".snd"
 static const int kAuHeaderSize = 24;
 
+// Source truncated by another process while mapped raises SIGBUS on touching pages past its new end,
+// which cannot be recovered from. Files opened with FormatFile::OpenFlag_MayChange are never mapped.
+// Others are mapped by windows and file size is checked before each window, so truncation is reported
+// as read error unless it happens while a window is being read.
+static const qint64 kMapWindowSize = 4*1024*1024;
+
 enum AuEncoding
 {
 	AuEncoding_ULaw_8   = 1,  // 8-bit ISDN u-law
@@ -143,6 +153,11 @@ WaveFormatDevice::WaveFormatDevice( WaveFormatFile * const formatFile ) :
 	isWave_ = false;
 	isAu_ = false;
 
+	isMappable_ = false;
+	mappedData_ = 0;
+	mappedOffset_ = 0;
+	mappedSize_ = 0;
+
 	pos_ = -1;
 }
 
@@ -426,14 +441,30 @@ bool WaveFormatDevice::_openAu()
 
 qint64 WaveFormatDevice::_readData( char * const data, const qint64 maxSize )
 {
-	qint64 bytesToRead = qMin( outputSize_ - pos_, maxSize );
+	const qint64 bytesToRead = qMin( outputSize_ - pos_, maxSize );
+	const qint64 inputBytes = bytesToRead / _codecMultiplier();
 
-	QByteArray buffer;
-	buffer.resize( bytesToRead / _codecMultiplier() );
-	if ( file_.read( buffer.data(), buffer.size() ) != buffer.size() )
-		return -1;
+	const uchar * input = 0;
+	if ( isMappable_ )
+	{
+		bool isError;
+		input = _mapInput( dataPos_ + pos_ / _codecMultiplier(), inputBytes, isError );
+		if ( isError )
+			return -1;
+	}
+
+	if ( input )
+	{
+		codec_( input, int(inputBytes), data );
+	}
+	else
+	{
+		readBuffer_.resize( int(inputBytes) );
+		if ( file_.read( readBuffer_.data(), inputBytes ) != inputBytes )
+			return -1;
 
-	codec_( buffer.constData(), buffer.size(), data );
+		codec_( readBuffer_.constData(), int(inputBytes), data );
+	}
 
 	pos_ += bytesToRead;
 
@@ -578,12 +609,72 @@ bool WaveFormatDevice::open( const QIODevice::OpenMode openMode )
 	if ( !_open( formatFile_->format(), true ) )
 		return false;
 
+	isMappable_ = !isSequential_ && !(formatFile_->openFlags() & FormatFile::OpenFlag_MayChange);
+
 	setOpenMode( openMode );
 
 	return true;
 }
 
 
+// Returns pointer to inputBytes of file at inputPos, remapping window if needed.
+// Returns 0 if file cannot be mapped, it is read as usual from inputPos then.
+// isError is set if file became shorter than expected.
+const uchar * WaveFormatDevice::_mapInput( const qint64 inputPos, const qint64 inputBytes, bool & isError )
+{
+	isError = false;
+
+	if ( mappedData_ && inputPos >= mappedOffset_ && inputPos + inputBytes <= mappedOffset_ + mappedSize_ )
+		return mappedData_ + (inputPos - mappedOffset_);
+
+	_unmap();
+
+	// QFile::size() asks file system, so truncation by other process is noticed here
+	const qint64 fileSize = file_.size();
+	if ( inputPos + inputBytes > fileSize )
+	{
+		isError = true;
+		return 0;
+	}
+
+	const qint64 offset = inputPos - inputPos % kMapWindowSize;
+	const qint64 size = qMin( fileSize - offset, qMax( kMapWindowSize, inputPos + inputBytes - offset ) );
+
+	// mapping may fail, e.g. on file systems without support, file is read as usual then
+	uchar * const data = file_.map( offset, size );
+	if ( !data )
+	{
+		isMappable_ = false;
+		if ( !file_.seek( inputPos ) )
+			isError = true;
+		return 0;
+	}
+
+#ifdef Q_OS_UNIX
+	posix_madvise( data, size, POSIX_MADV_SEQUENTIAL );
+#endif
+
+	mappedData_ = data;
+	mappedOffset_ = offset;
+	mappedSize_ = size;
+
+	return mappedData_ + (inputPos - mappedOffset_);
+}
+
+
+void WaveFormatDevice::_unmap()
+{
+	if ( !mappedData_ )
+		return;
+
+	file_.unmap( const_cast<uchar*>( mappedData_ ) );
+
+	mappedData_ = 0;
+	mappedOffset_ = 0;
+	mappedSize_ = 0;
+}
+
+
 void WaveFormatDevice::_close()
 {
 	if ( pos_ == -1 )
@@ -601,6 +692,10 @@ void WaveFormatDevice::close()
 	QIODevice::close();
 
 	_close();
+	_unmap();
+	isMappable_ = false;
+
+	readBuffer_ = QByteArray();
 
 	file_.close();
 }
@@ -704,7 +799,8 @@ bool WaveFormatDevice::seek( qint64 pos )
 
 	const qint64 outputPos = dataPos_ + pos / _codecMultiplier();
 
-	if ( !file_.seek( outputPos ) )
+	// mapped data is addressed by position, file is not read
+	if ( !isMappable_ && !file_.seek( outputPos ) )
 		return false;
 
 	pos_ = pos;
@@ -713,6 +809,39 @@ bool WaveFormatDevice::seek( qint64 pos )
 }
 
 
+const char * WaveFormatDevice::readView( const qint64 maxSize, qint64 & size )
+{
+	Q_ASSERT( isOpen() );
+
+	size = 0;
+
+	// only data stored as is can be pointed directly
+	if ( !isMappable_ || codec_ != _linearCodec )
+		return 0;
+
+	const qint64 bytesToRead = qMin( outputSize_ - pos_, formatFile_->truncatedSize( maxSize ) );
+
+	bool isError;
+	const uchar * const input = _mapInput( dataPos_ + pos_, bytesToRead, isError );
+	if ( isError )
+	{
+		size = -1;
+		return 0;
+	}
+
+	if ( !input )
+		return 0;
+
+	pos_ += bytesToRead;
+
+	// data bypasses QIODevice::read(), keep its position in sync
+	QIODevice::seek( pos_ );
+
+	size = bytesToRead;
+	return reinterpret_cast<const char*>( input );
+}
+
+
 
 
 WaveFormatFile::WaveFormatFile( const QString & fileName, const QString & format,
@@ -729,6 +858,12 @@ QIODevice * WaveFormatFile::device()
 }
 
 
+const char * WaveFormatFile::readView( const qint64 maxSize, qint64 & size )
+{
+	return device_.readView( maxSize, size );
+}
+
+
 
 
 QStringList WaveFormatPlugin::formats() const
@@ -43,6 +43,8 @@ public:
 
 	bool seek( qint64 pos );
 
+	const char * readView( qint64 maxSize, qint64 & size );
+
 private:
 	int _codecMultiplier() const;
 
@@ -60,11 +62,21 @@ private:
 	bool _open( const QString & format, bool firstTime );
 	void _close();
 
+	const uchar * _mapInput( qint64 inputPos, qint64 inputBytes, bool & isError );
+	void _unmap();
+
 private:
 	WaveFormatFile * formatFile_;
 
 	QFile file_;
 
+	// file is mapped by windows when possible, codec reads directly from mapping then
+	bool isMappable_;
+	const uchar * mappedData_;
+	qint64 mappedOffset_;
+	qint64 mappedSize_;
+	QByteArray readBuffer_;
+
 	bool isSequential_;
 
 	bool isWave_;
@@ -88,6 +100,8 @@ public:
 
 	QIODevice * device();
 
+	const char * readView( qint64 maxSize, qint64 & size );
+
 private:
 	WaveFormatDevice device_;
 
@@ -20,20 +20,27 @@ static const int kMaximumConcurrentThreadCount = 16;
 // defaults
 static const QString kDefaultLanguageValue = QString();
 
+static const bool    kDefaultSplitLongFilesValue = false;
+
 static const qreal   kDefaultQualityValue = 0.2;
+static const int     kDefaultSampleRateValue = 0;
 static const bool    kDefaultPrependYearToAlbumValue = false;
 
+static const bool    kDefaultWatchSourceDirsValue = false;
+
 static const bool    kDefaultMainWindowStayOnTop = true;
 static const bool    kDefaultMainWindowMaximized = false;
 
 // property keys
 static const QString kLanguageKey                  = QLatin1String( "language" );
 static const QString kConcurrentThreadCountKey     = QLatin1String( "concurrent-thread-count" );
+static const QString kSplitLongFilesKey            = QLatin1String( "split-long-files" );
 static const QString kDefaultQualityKey            = QLatin1String( "default-quality" );
 static const QString kCurrentCustomProfileIndexKey = QLatin1String( "current-custom-profile-index" );
 static const QString kFileSystemProfileKey         = QLatin1String( "file-system-profile" );
 static const QString kCustomProfilesKey            = QLatin1String( "custom-profiles" );
 static const QString kSourceDirsKey                = QLatin1String( "source-dirs" );
+static const QString kWatchSourceDirsKey           = QLatin1String( "watch-source-dirs" );
 static const QString kMainWindowStayOnTopKey       = QLatin1String( "main-window-stay-on-top" );
 static const QString kMainWindowGeometryKey        = QLatin1String( "main-window-geometry" );
 static const QString kMainWindowMaximizedKey       = QLatin1String( "main-window-maximized" );
@@ -44,6 +51,11 @@ static const QString kJobViewHeaderStateKey        = QLatin1String( "job-view-he
 static const QString kProfileNameKey               = QLatin1String( "name" );
 static const QString kProfilePathKey               = QLatin1String( "path" );
 static const QString kProfileQualityKey            = QLatin1String( "quality" );
+static const QString kProfileBitrateModeKey        = QLatin1String( "bitrate-mode" );
+static const QString kProfileMinimumBitrateKey     = QLatin1String( "minimum-bitrate" );
+static const QString kProfileNominalBitrateKey     = QLatin1String( "nominal-bitrate" );
+static const QString kProfileMaximumBitrateKey     = QLatin1String( "maximum-bitrate" );
+static const QString kProfileSampleRateKey         = QLatin1String( "sample-rate" );
 static const QString kProfilePrependYearToAlbumKey = QLatin1String( "prepend-year-to-album" );
 
 // source dir property keys
@@ -68,10 +80,12 @@ void Config::_clear()
 	customProfileIds_.clear();
 	customProfiles_.clear();
 
+	splitLongFiles_ = kDefaultSplitLongFilesValue;
 	defaultQuality_ = kDefaultQualityValue;
 	currentCustomProfileIndex_ = -1;
 
 	sourceDirs_.clear();
+	watchSourceDirs_ = kDefaultWatchSourceDirsValue;
 
 	mainWindowStayOnTop_ = kDefaultMainWindowStayOnTop;
 	mainWindowGeometry_ = QRect();
@@ -97,6 +111,9 @@ bool Config::load()
 	if ( concurrentThreadCount() < 0 || concurrentThreadCount() > maximumConcurrentThreadCount() )
 		concurrentThreadCount_ = 0;
 
+	// load split long files
+	splitLongFiles_ = settings.value( kSplitLongFilesKey, kDefaultSplitLongFilesValue ).toBool();
+
 	// load default quality
 	defaultQuality_ = settings.value( kDefaultQualityKey, kDefaultQualityValue ).toReal();
 
@@ -147,6 +164,9 @@ bool Config::load()
 	}
 	settings.endArray();
 
+	// load watch source dirs
+	watchSourceDirs_ = settings.value( kWatchSourceDirsKey, kDefaultWatchSourceDirsValue ).toBool();
+
 	// user interface
 	mainWindowStayOnTop_ = settings.value( kMainWindowStayOnTopKey, kDefaultMainWindowStayOnTop ).toBool();
 	mainWindowGeometry_ = settings.value( kMainWindowGeometryKey ).toRect();
@@ -170,6 +190,9 @@ bool Config::save()
 	// save concurrent thread count
 	settings.setValue( kConcurrentThreadCountKey, concurrentThreadCount() );
 
+	// save split long files
+	settings.setValue( kSplitLongFilesKey, splitLongFiles() );
+
 	// save default quality
 	settings.setValue( kDefaultQualityKey, defaultQuality() );
 
@@ -200,6 +223,9 @@ bool Config::save()
 	}
 	settings.endArray();
 
+	// save watch source dirs
+	settings.setValue( kWatchSourceDirsKey, watchSourceDirs() );
+
 	// user interface
 	settings.setValue( kMainWindowStayOnTopKey, mainWindowStayOnTop() );
 	settings.setValue( kMainWindowGeometryKey, mainWindowGeometry() );
@@ -227,6 +253,12 @@ void Config::setConcurrentThreadCount( const int count )
 }
 
 
+void Config::setSplitLongFiles( const bool set )
+{
+	splitLongFiles_ = set;
+}
+
+
 void Config::setDefaultQuality( const qreal quality )
 {
 	Q_ASSERT( quality >= kMinimumQualityValue && quality <= kMaximumQualityValue );
@@ -245,7 +277,8 @@ int Config::addCustomProfile()
 	Profile & profile = customProfiles_[ customProfileId ];
 	profile.isNull_ = false;
 	profile.path = _defaultFileSystemPath();
-	profile.quality = defaultQuality_;
+	profile.encoderSettings = EncoderSettings::fromQuality( defaultQuality_ );
+	profile.sampleRate = kDefaultSampleRateValue;
 	profile.prependYearToAlbum = kDefaultPrependYearToAlbumValue;
 
 	customProfileIds_ << customProfileId;
@@ -301,6 +334,12 @@ void Config::setSourceDirs( const QList<SourceDir> & sourceDirs )
 }
 
 
+void Config::setWatchSourceDirs( const bool set )
+{
+	watchSourceDirs_ = set;
+}
+
+
 void Config::setMainWindowStayOnTop( const bool set )
 {
 	mainWindowStayOnTop_ = set;
@@ -340,7 +379,8 @@ QString Config::_defaultFileSystemPath() const
 void Config::_assertProfile( const Profile & profile )
 {
 	Q_ASSERT( !profile.isNull() );
-	Q_ASSERT( profile.quality >= kMinimumQualityValue && profile.quality <= kMaximumQualityValue );
+	Q_ASSERT( profile.encoderSettings.isValid() );
+	Q_ASSERT( profile.sampleRate == 0 || (profile.sampleRate >= kMinimumSampleRateValue && profile.sampleRate <= kMaximumSampleRateValue) );
 }
 
 
@@ -350,7 +390,10 @@ Config::Profile Config::_loadProfileFromSettings( QSettings & settings )
 	profile.isNull_ = false;
 	profile.name = settings.value( kProfileNameKey ).toString();
 	profile.path = settings.value( kProfilePathKey, _defaultFileSystemPath() ).toString();
-	profile.quality = qBound<qreal>( 0.0, settings.value( kProfileQualityKey, kDefaultQualityValue ).toReal(), 1.0 );
+	profile.encoderSettings = _loadEncoderSettingsFromSettings( settings );
+	profile.sampleRate = settings.value( kProfileSampleRateKey, kDefaultSampleRateValue ).toInt();
+	if ( profile.sampleRate != 0 && (profile.sampleRate < kMinimumSampleRateValue || profile.sampleRate > kMaximumSampleRateValue) )
+		profile.sampleRate = kDefaultSampleRateValue;
 	profile.prependYearToAlbum = settings.value( kProfilePrependYearToAlbumKey, kDefaultPrependYearToAlbumValue ).toBool();
 	return profile;
 }
@@ -361,11 +404,44 @@ void Config::_saveProfileToSettings( QSettings & settings, const Profile & profi
 	_assertProfile( profile );
 	settings.setValue( kProfileNameKey, profile.name );
 	settings.setValue( kProfilePathKey, profile.path );
-	settings.setValue( kProfileQualityKey, profile.quality );
+	_saveEncoderSettingsToSettings( settings, profile.encoderSettings );
+	settings.setValue( kProfileSampleRateKey, profile.sampleRate );
 	settings.setValue( kProfilePrependYearToAlbumKey, profile.prependYearToAlbum );
 }
 
 
 
+// Profiles saved before managed bitrate modes have quality only and load as quality mode.
+// Invalid bitrates fall back to quality mode too, rather than failing every conversion.
+EncoderSettings Config::_loadEncoderSettingsFromSettings( QSettings & settings )
+{
+	EncoderSettings encoderSettings;
+	encoderSettings.mode = EncoderSettings::modeForName( settings.value( kProfileBitrateModeKey ).toString() );
+	encoderSettings.quality = qBound<qreal>( 0.0, settings.value( kProfileQualityKey, kDefaultQualityValue ).toReal(), 1.0 );
+	encoderSettings.minimumBitrate = settings.value( kProfileMinimumBitrateKey, -1 ).toInt();
+	encoderSettings.nominalBitrate = settings.value( kProfileNominalBitrateKey, -1 ).toInt();
+	encoderSettings.maximumBitrate = settings.value( kProfileMaximumBitrateKey, -1 ).toInt();
+
+	if ( !encoderSettings.isValid() )
+	{
+		foggWarning() << "Invalid bitrates in profile, using quality mode:" << settings.value( kProfileNameKey ).toString();
+		encoderSettings.mode = EncoderSettings::Mode_Quality;
+	}
+
+	return encoderSettings;
+}
+
+
+void Config::_saveEncoderSettingsToSettings( QSettings & settings, const EncoderSettings & encoderSettings )
+{
+	// quality is kept in managed modes too, so switching back to quality mode restores it
+	settings.setValue( kProfileBitrateModeKey, EncoderSettings::nameForMode( encoderSettings.mode ) );
+	settings.setValue( kProfileQualityKey, encoderSettings.quality );
+	settings.setValue( kProfileMinimumBitrateKey, encoderSettings.minimumBitrate );
+	settings.setValue( kProfileNominalBitrateKey, encoderSettings.nominalBitrate );
+	settings.setValue( kProfileMaximumBitrateKey, encoderSettings.maximumBitrate );
+}
+
+
 
 } // namespace Fogg
@@ -8,6 +8,7 @@
 #include <grim/tools/IdGenerator.h>
 
 #include "Global.h"
+#include "EncoderSettings.h"
 
 
 
@@ -31,14 +32,16 @@ public:
 	{
 	public:
 		Profile() :
-			isNull_( true )
+			sampleRate( 0 ), isNull_( true )
 		{}
 
 		bool isNull() const
 		{ return isNull_; }
 
 		QString name;
-		qreal quality;
+		EncoderSettings encoderSettings;
+		// 0 keeps source sample rate
+		int sampleRate;
 		QString path;
 		bool prependYearToAlbum;
 
@@ -78,6 +81,9 @@ public:
 	int concurrentThreadCount() const;
 	void setConcurrentThreadCount( int count );
 
+	bool splitLongFiles() const;
+	void setSplitLongFiles( bool set );
+
 	qreal defaultQuality() const;
 	void setDefaultQuality( qreal quality );
 
@@ -98,6 +104,9 @@ public:
 	QList<SourceDir> sourceDirs() const;
 	void setSourceDirs( const QList<SourceDir> & sourceDirs );
 
+	bool watchSourceDirs() const;
+	void setWatchSourceDirs( bool set );
+
 	bool mainWindowStayOnTop() const;
 	void setMainWindowStayOnTop( bool set );
 
@@ -120,12 +129,15 @@ private:
 	void _assertProfile( const Profile & profile );
 	Profile _loadProfileFromSettings( QSettings & settings );
 	void _saveProfileToSettings( QSettings & settings, const Profile & profile );
+	EncoderSettings _loadEncoderSettingsFromSettings( QSettings & settings );
+	void _saveEncoderSettingsToSettings( QSettings & settings, const EncoderSettings & encoderSettings );
 
 private:
 	// general
 	QString language_;
 	int maximumConcurrentThreadCount_;
 	int concurrentThreadCount_;
+	bool splitLongFiles_;
 	qreal defaultQuality_;
 
 	// profiles
@@ -137,6 +149,7 @@ private:
 
 	// sources
 	QList<SourceDir> sourceDirs_;
+	bool watchSourceDirs_;
 
 	// user interface
 	bool mainWindowStayOnTop_;
@@ -160,6 +173,9 @@ inline int Config::maximumConcurrentThreadCount() const
 inline int Config::concurrentThreadCount() const
 { return concurrentThreadCount_; }
 
+inline bool Config::splitLongFiles() const
+{ return splitLongFiles_; }
+
 inline qreal Config::defaultQuality() const
 { return defaultQuality_; }
 
@@ -178,6 +194,9 @@ inline int Config::currentCustomProfileIndex() const
 inline QList<Config::SourceDir> Config::sourceDirs() const
 {  return sourceDirs_; }
 
+inline bool Config::watchSourceDirs() const
+{ return watchSourceDirs_; }
+
 inline bool Config::mainWindowStayOnTop() const
 { return mainWindowStayOnTop_; }
 
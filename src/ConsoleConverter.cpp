@@ -0,0 +1,218 @@
+
+#include "ConsoleConverter.h"
+
+#include <QFileInfo>
+#include <QDir>
+#include <QUrl>
+
+#include <grim/audio/FormatManager.h>
+
+#include "Global.h"
+#include "Converter.h"
+#include "FileFetcher.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+static const QString kOggSuffix = QLatin1String( "ogg" );
+
+
+
+
+ConsoleConverter::ConsoleConverter( Converter * const converter, QObject * const parent ) :
+	QObject( parent ),
+	output_( stdout )
+{
+	converter_ = converter;
+
+	sampleRate_ = 0;
+	prependYearToAlbum_ = false;
+
+	doneJobCount_ = 0;
+	failedJobCount_ = 0;
+
+	fileFetcher_ = new FileFetcher( this );
+	connect( fileFetcher_, SIGNAL(fetched(QStringList,QString,bool)), SLOT(_fetched(QStringList,QString,bool)) );
+	connect( fileFetcher_, SIGNAL(finished()), SLOT(_fetchFinished()) );
+
+	connect( converter_, SIGNAL(jobStarted(int)), SLOT(_jobStarted(int)) );
+	connect( converter_, SIGNAL(jobsProgress(QVector<QPair<int,qreal> >)), SLOT(_jobsProgress(QVector<QPair<int,qreal> >)) );
+	connect( converter_, SIGNAL(jobFinished(int,int)), SLOT(_jobFinished(int,int)) );
+}
+
+
+void ConsoleConverter::setSourcePaths( const QStringList & paths )
+{
+	sourcePaths_ = paths;
+}
+
+
+void ConsoleConverter::setDestinationPath( const QString & path )
+{
+	destinationPath_ = path;
+}
+
+
+void ConsoleConverter::setEncoderSettings( const EncoderSettings & encoderSettings )
+{
+	Q_ASSERT( encoderSettings.isValid() );
+
+	encoderSettings_ = encoderSettings;
+}
+
+
+void ConsoleConverter::setSampleRate( const int sampleRate )
+{
+	Q_ASSERT( sampleRate == 0 || (sampleRate >= kMinimumSampleRateValue && sampleRate <= kMaximumSampleRateValue) );
+
+	sampleRate_ = sampleRate;
+}
+
+
+void ConsoleConverter::setPrependYearToAlbum( const bool set )
+{
+	prependYearToAlbum_ = set;
+}
+
+
+void ConsoleConverter::setScanIndex( ScanIndex * const scanIndex )
+{
+	fileFetcher_->setScanIndex( scanIndex );
+}
+
+
+void ConsoleConverter::start()
+{
+	time_.start();
+
+	QList<QUrl> urls;
+	foreach ( const QString & path, sourcePaths_ )
+		urls << QUrl::fromLocalFile( QFileInfo( path ).absoluteFilePath() );
+
+	fileFetcher_->setUrls( urls );
+	fileFetcher_->setFilters( Global::fileFiltersForExtensions( converter_->audioFormatManager()->allAvailableFileExtensions() ) );
+	fileFetcher_->start();
+}
+
+
+QString ConsoleConverter::_nameForJobResult( const int result )
+{
+	switch ( result )
+	{
+	case Converter::JobResult_Done:         return QLatin1String( "done" );
+	case Converter::JobResult_ReadError:    return QLatin1String( "read-error" );
+	case Converter::JobResult_NotSupported: return QLatin1String( "not-supported" );
+	case Converter::JobResult_ConvertError: return QLatin1String( "convert-error" );
+	case Converter::JobResult_WriteError:   return QLatin1String( "write-error" );
+	case Converter::JobResult_UpToDate:     return QLatin1String( "up-to-date" );
+	}
+
+	Q_ASSERT( false );
+	return QString();
+}
+
+
+QString ConsoleConverter::_destinationPathForFile( const QString & filePath, const QString & basePath ) const
+{
+	const QString relativePath = QDir( basePath ).relativeFilePath( filePath );
+	const QString suffix = QFileInfo( relativePath ).suffix();
+	const QString oggedRelativePath = suffix.isEmpty() ?
+			relativePath + QLatin1Char( '.' ) + kOggSuffix :
+			relativePath.left( relativePath.length() - suffix.length() ) + kOggSuffix;
+
+	return QDir( destinationPath_ ).absoluteFilePath( oggedRelativePath );
+}
+
+
+void ConsoleConverter::_checkFinished()
+{
+	if ( fileFetcher_->isRunning() || !jobInfoForId_.isEmpty() )
+		return;
+
+	output_ << "summary\t" << doneJobCount_ << '\t' << failedJobCount_ << '\t'
+			<< QString::number( time_.elapsed() / 1000.0, 'f', 3 ) << endl;
+
+	emit finished();
+}
+
+
+void ConsoleConverter::_fetched( const QStringList & filePaths, const QString & basePath, const bool extensionRecognized )
+{
+	foreach ( const QString & filePath, filePaths )
+	{
+		if ( extensionRecognized )
+			_addJob( filePath, basePath );
+		else
+			output_ << "skipped\t" << QDir::toNativeSeparators( filePath ) << endl;
+	}
+}
+
+
+void ConsoleConverter::_addJob( const QString & filePath, const QString & basePath )
+{
+	const QStringList formats = converter_->audioFormatManager()->formatsForExtension( QFileInfo( filePath ).suffix() );
+	Q_ASSERT( !formats.isEmpty() );
+
+	const QString destinationFilePath = _destinationPathForFile( filePath, basePath );
+
+	const int jobId = converter_->addJob( filePath, formats.first(), destinationFilePath,
+			encoderSettings_, sampleRate_, prependYearToAlbum_, false );
+
+	JobInfo jobInfo;
+	jobInfo.sourcePath = filePath;
+	jobInfo.sourceSize = QFileInfo( filePath ).size();
+	jobInfoForId_[ jobId ] = jobInfo;
+
+	output_ << "added\t" << jobId << '\t' << QDir::toNativeSeparators( filePath ) << '\t'
+			<< QDir::toNativeSeparators( destinationFilePath ) << endl;
+}
+
+
+void ConsoleConverter::_fetchFinished()
+{
+	_checkFinished();
+}
+
+
+void ConsoleConverter::_jobStarted( const int jobId )
+{
+	jobInfoForId_[ jobId ].startTime.start();
+
+	output_ << "started\t" << jobId << endl;
+}
+
+
+void ConsoleConverter::_jobsProgress( const QVector<QPair<int,qreal> > & progress )
+{
+	for ( int i = 0; i < progress.count(); ++i )
+		output_ << "progress\t" << progress.at( i ).first << '\t' << QString::number( progress.at( i ).second*100, 'f', 1 ) << endl;
+}
+
+
+void ConsoleConverter::_jobFinished( const int jobId, const int result )
+{
+	const JobInfo jobInfo = jobInfoForId_.take( jobId );
+
+	if ( result == Converter::JobResult_Done || result == Converter::JobResult_UpToDate )
+		doneJobCount_++;
+	else
+		failedJobCount_++;
+
+	const int elapsed = jobInfo.startTime.elapsed();
+	const qint64 bytesPerSecond = elapsed == 0 ? 0 : jobInfo.sourceSize * 1000 / elapsed;
+
+	output_ << "finished\t" << jobId << '\t' << _nameForJobResult( result ) << '\t'
+			<< QString::number( elapsed / 1000.0, 'f', 3 ) << '\t' << bytesPerSecond << endl;
+
+	_checkFinished();
+}
+
+
+
+
+} // namespace Fogg
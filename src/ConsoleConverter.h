@@ -0,0 +1,109 @@
+
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QPair>
+#include <QTime>
+#include <QTextStream>
+
+#include "EncoderSettings.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+class Converter;
+class FileFetcher;
+class ScanIndex;
+
+
+
+
+// Drives Converter without user interface, for the fogg-cli tool.
+// Reports progress to standard output as tab separated lines:
+//   added     <job id> <source path> <destination path>
+//   started   <job id>
+//   progress  <job id> <percents>
+//   finished  <job id> <result> <seconds> <source bytes per second>
+//   skipped   <source path>
+//   summary   <done count> <failed count> <seconds>
+class ConsoleConverter : public QObject
+{
+	Q_OBJECT
+
+public:
+	ConsoleConverter( Converter * converter, QObject * parent = 0 );
+
+	void setSourcePaths( const QStringList & paths );
+	void setDestinationPath( const QString & path );
+	void setEncoderSettings( const EncoderSettings & encoderSettings );
+	void setSampleRate( int sampleRate );
+	void setPrependYearToAlbum( bool set );
+	void setScanIndex( ScanIndex * scanIndex );
+
+	int failedJobCount() const;
+
+public slots:
+	void start();
+
+signals:
+	void finished();
+
+private:
+	class JobInfo
+	{
+	public:
+		QString sourcePath;
+		qint64 sourceSize;
+		QTime startTime;
+	};
+
+	static QString _nameForJobResult( int result );
+
+	QString _destinationPathForFile( const QString & filePath, const QString & basePath ) const;
+	void _addJob( const QString & filePath, const QString & basePath );
+	void _checkFinished();
+
+private slots:
+	void _fetched( const QStringList & filePaths, const QString & basePath, bool extensionRecognized );
+	void _fetchFinished();
+
+	void _jobStarted( int jobId );
+	void _jobsProgress( const QVector<QPair<int,qreal> > & progress );
+	void _jobFinished( int jobId, int result );
+
+private:
+	Converter * converter_;
+	FileFetcher * fileFetcher_;
+
+	QStringList sourcePaths_;
+	QString destinationPath_;
+	EncoderSettings encoderSettings_;
+	int sampleRate_;
+	bool prependYearToAlbum_;
+
+	QTextStream output_;
+	QTime time_;
+
+	QHash<int,JobInfo> jobInfoForId_;
+	int doneJobCount_;
+	int failedJobCount_;
+};
+
+
+
+
+inline int ConsoleConverter::failedJobCount() const
+{ return failedJobCount_; }
+
+
+
+
+} // namespace Fogg
@@ -0,0 +1,303 @@
+
+#include "ConversionManifest.h"
+
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDataStream>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include <vorbis/codec.h>
+
+#include "Global.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+static const QString kManifestFileName = QLatin1String( "conversion-manifest" );
+
+static const quint32 kManifestMagic = 0x666f6d66; // "fomf"
+static const quint32 kManifestVersion = 1;
+
+// content hash covers head and tail of the source file
+static const qint64 kHashChunkSize = 64*1024;
+
+
+
+
+class ConversionManifestSaver : public QRunnable
+{
+public:
+	ConversionManifestSaver( ConversionManifest * const manifest ) :
+		manifest_( manifest )
+	{}
+
+	void run()
+	{ manifest_->save(); }
+
+private:
+	ConversionManifest * manifest_;
+};
+
+
+
+
+ConversionManifest::ConversionManifest()
+{
+	isChanged_ = false;
+	saveThreadPool_.setMaxThreadCount( 1 );
+}
+
+
+ConversionManifest::~ConversionManifest()
+{
+	saveThreadPool_.waitForDone();
+}
+
+
+QString ConversionManifest::_filePath()
+{
+	return QDir( QStandardPaths::writableLocation( QStandardPaths::DataLocation ) ).absoluteFilePath( kManifestFileName );
+}
+
+
+QString ConversionManifest::_encoderVersion()
+{
+	return QString::fromLatin1( vorbis_version_string() );
+}
+
+
+QByteArray ConversionManifest::_hashForFile( const QString & filePath, const qint64 size )
+{
+	QFile file( filePath );
+	if ( !file.open( QIODevice::ReadOnly ) )
+		return QByteArray();
+
+	QCryptographicHash hash( QCryptographicHash::Sha1 );
+	hash.addData( QByteArray::number( size ) );
+	hash.addData( file.read( kHashChunkSize ) );
+
+	if ( size > kHashChunkSize )
+	{
+		if ( !file.seek( qMax( kHashChunkSize, size - kHashChunkSize ) ) )
+			return QByteArray();
+		hash.addData( file.read( kHashChunkSize ) );
+	}
+
+	return hash.result();
+}
+
+
+ConversionManifest::SourceState ConversionManifest::sourceStateForFile( const QString & sourceFilePath )
+{
+	const QFileInfo sourceFileInfo( sourceFilePath );
+
+	SourceState sourceState;
+	if ( !sourceFileInfo.exists() )
+		return sourceState;
+
+	sourceState.size = sourceFileInfo.size();
+	sourceState.modified = sourceFileInfo.lastModified().toMSecsSinceEpoch();
+	sourceState.hash = _hashForFile( sourceFilePath, sourceState.size );
+	return sourceState;
+}
+
+
+void ConversionManifest::load()
+{
+	QMutexLocker locker( &mutex_ );
+
+	entryForDestination_.clear();
+	isChanged_ = false;
+
+	QFile file( _filePath() );
+	if ( !file.open( QIODevice::ReadOnly ) )
+		return;
+
+	QDataStream stream( &file );
+
+	quint32 magic;
+	quint32 version;
+	stream >> magic >> version;
+	if ( magic != kManifestMagic || version != kManifestVersion )
+	{
+		foggWarning() << "Conversion manifest has unknown format, ignoring:" << file.fileName();
+		return;
+	}
+
+	qint32 count;
+	stream >> count;
+
+	for ( int i = 0; i < count && stream.status() == QDataStream::Ok; ++i )
+	{
+		QString destinationFilePath;
+		Entry entry;
+		stream >> destinationFilePath
+				>> entry.sourceFilePath >> entry.sourceSize >> entry.sourceModified >> entry.sourceHash
+				>> entry.destinationSize >> entry.destinationModified
+				>> entry.encoderSettings;
+
+		qint32 sampleRate;
+		stream >> sampleRate >> entry.prependYearToAlbum >> entry.encoderVersion;
+		entry.sampleRate = sampleRate;
+
+		if ( stream.status() == QDataStream::Ok )
+			entryForDestination_[ destinationFilePath ] = entry;
+	}
+
+	if ( stream.status() != QDataStream::Ok )
+		foggWarning() << "Conversion manifest is truncated:" << file.fileName();
+}
+
+
+void ConversionManifest::save()
+{
+	QMutexLocker saveLocker( &saveMutex_ );
+
+	// copy is shared until the next change, so taking it is cheap
+	QHash<QString,Entry> entryForDestination;
+	{
+		QMutexLocker locker( &mutex_ );
+		if ( !isChanged_ )
+			return;
+		entryForDestination = entryForDestination_;
+		isChanged_ = false;
+	}
+
+	const QString filePath = _filePath();
+	QDir().mkpath( QFileInfo( filePath ).path() );
+
+	QSaveFile file( filePath );
+	if ( !file.open( QIODevice::WriteOnly ) )
+	{
+		foggWarning() << "Error opening conversion manifest for write:" << filePath;
+		QMutexLocker locker( &mutex_ );
+		isChanged_ = true;
+		return;
+	}
+
+	QDataStream stream( &file );
+	stream << kManifestMagic << kManifestVersion << qint32(entryForDestination.count());
+
+	for ( QHash<QString,Entry>::const_iterator it = entryForDestination.constBegin(); it != entryForDestination.constEnd(); ++it )
+	{
+		const Entry & entry = it.value();
+		stream << it.key()
+				<< entry.sourceFilePath << entry.sourceSize << entry.sourceModified << entry.sourceHash
+				<< entry.destinationSize << entry.destinationModified
+				<< entry.encoderSettings << qint32(entry.sampleRate) << entry.prependYearToAlbum << entry.encoderVersion;
+	}
+
+	if ( !file.commit() )
+	{
+		foggWarning() << "Error writing conversion manifest:" << filePath;
+		QMutexLocker locker( &mutex_ );
+		isChanged_ = true;
+		return;
+	}
+}
+
+
+void ConversionManifest::saveInBackground()
+{
+	saveThreadPool_.start( new ConversionManifestSaver( this ) );
+}
+
+
+bool ConversionManifest::isUpToDate( const QString & sourceFilePath, const QString & destinationFilePath,
+		const EncoderSettings & encoderSettings, const int sampleRate, const bool prependYearToAlbum )
+{
+	Entry entry;
+	{
+		QMutexLocker locker( &mutex_ );
+		const QHash<QString,Entry>::const_iterator it = entryForDestination_.constFind( destinationFilePath );
+		if ( it == entryForDestination_.constEnd() )
+			return false;
+		entry = it.value();
+	}
+
+	if ( entry.sourceFilePath != sourceFilePath || entry.encoderSettings != encoderSettings ||
+			entry.sampleRate != sampleRate ||
+			entry.prependYearToAlbum != prependYearToAlbum || entry.encoderVersion != _encoderVersion() )
+		return false;
+
+	const QFileInfo destinationFileInfo( destinationFilePath );
+	if ( !destinationFileInfo.exists() || destinationFileInfo.size() != entry.destinationSize ||
+			destinationFileInfo.lastModified().toMSecsSinceEpoch() != entry.destinationModified )
+		return false;
+
+	const QFileInfo sourceFileInfo( sourceFilePath );
+	if ( !sourceFileInfo.exists() || sourceFileInfo.size() != entry.sourceSize )
+		return false;
+
+	const qint64 sourceModified = sourceFileInfo.lastModified().toMSecsSinceEpoch();
+	if ( sourceModified == entry.sourceModified )
+		return true;
+
+	// source was touched, compare its content
+	if ( entry.sourceHash.isEmpty() || _hashForFile( sourceFilePath, entry.sourceSize ) != entry.sourceHash )
+		return false;
+
+	{
+		QMutexLocker locker( &mutex_ );
+		QHash<QString,Entry>::iterator it = entryForDestination_.find( destinationFilePath );
+		if ( it != entryForDestination_.end() )
+		{
+			it.value().sourceModified = sourceModified;
+			isChanged_ = true;
+		}
+	}
+
+	return true;
+}
+
+
+void ConversionManifest::update( const QString & sourceFilePath, const SourceState & sourceState,
+		const QString & destinationFilePath, const EncoderSettings & encoderSettings, const int sampleRate,
+		const bool prependYearToAlbum )
+{
+	const QFileInfo sourceFileInfo( sourceFilePath );
+	const QFileInfo destinationFileInfo( destinationFilePath );
+
+	// source was written while converting, destination might mix old and new contents,
+	// so it is left unrecorded and converted again next time
+	if ( sourceState.size == -1 || !sourceFileInfo.exists() || sourceFileInfo.size() != sourceState.size ||
+			sourceFileInfo.lastModified().toMSecsSinceEpoch() != sourceState.modified )
+	{
+		QMutexLocker locker( &mutex_ );
+		if ( entryForDestination_.remove( destinationFilePath ) != 0 )
+			isChanged_ = true;
+		return;
+	}
+
+	Entry entry;
+	entry.sourceFilePath = sourceFilePath;
+	entry.sourceSize = sourceState.size;
+	entry.sourceModified = sourceState.modified;
+	entry.sourceHash = sourceState.hash;
+	entry.destinationSize = destinationFileInfo.size();
+	entry.destinationModified = destinationFileInfo.lastModified().toMSecsSinceEpoch();
+	entry.encoderSettings = encoderSettings;
+	entry.sampleRate = sampleRate;
+	entry.prependYearToAlbum = prependYearToAlbum;
+	entry.encoderVersion = _encoderVersion();
+
+	QMutexLocker locker( &mutex_ );
+	entryForDestination_[ destinationFilePath ] = entry;
+	isChanged_ = true;
+}
+
+
+
+
+} // namespace Fogg
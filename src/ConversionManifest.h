@@ -0,0 +1,100 @@
+
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+
+#include "EncoderSettings.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+// Remembers which source and encoder settings each destination file was converted from,
+// so up to date destinations are not converted again.
+// Source files are compared by size and modification time, content hash is evaluated
+// only when modification time differs, e.g. after the file was copied or touched.
+// Accessed from Job threads, all public methods are thread safe.
+// Saving writes a snapshot of entries outside of the lock, so jobs never wait for disk.
+class ConversionManifest
+{
+public:
+	// Source file as it was when conversion has started.
+	class SourceState
+	{
+	public:
+		SourceState() :
+			size( -1 ), modified( 0 )
+		{}
+
+		qint64 size;
+		qint64 modified;
+		QByteArray hash;
+	};
+
+	ConversionManifest();
+	~ConversionManifest();
+
+	void load();
+	void save();
+
+	// Same as save(), but on a background thread. Destructor waits for it to finish.
+	void saveInBackground();
+
+	// Evaluated before the first read of the source and passed later to update(),
+	// so destination built from old contents is never recorded for the changed source.
+	static SourceState sourceStateForFile( const QString & sourceFilePath );
+
+	bool isUpToDate( const QString & sourceFilePath, const QString & destinationFilePath,
+			const EncoderSettings & encoderSettings, int sampleRate, bool prependYearToAlbum );
+	void update( const QString & sourceFilePath, const SourceState & sourceState, const QString & destinationFilePath,
+			const EncoderSettings & encoderSettings, int sampleRate, bool prependYearToAlbum );
+
+private:
+	class Entry
+	{
+	public:
+		Entry() :
+			sourceSize( 0 ), sourceModified( 0 ), destinationSize( 0 ), destinationModified( 0 ),
+			sampleRate( 0 ), prependYearToAlbum( false )
+		{}
+
+		QString sourceFilePath;
+		qint64 sourceSize;
+		qint64 sourceModified;
+		QByteArray sourceHash;
+
+		qint64 destinationSize;
+		qint64 destinationModified;
+
+		EncoderSettings encoderSettings;
+		int sampleRate;
+		bool prependYearToAlbum;
+		QString encoderVersion;
+	};
+
+	static QString _filePath();
+	static QString _encoderVersion();
+	static QByteArray _hashForFile( const QString & filePath, qint64 size );
+
+private:
+	QMutex mutex_;
+	QHash<QString,Entry> entryForDestination_;
+	bool isChanged_;
+
+	// serializes saves, so snapshots are written in the order they were taken
+	QMutex saveMutex_;
+	QThreadPool saveThreadPool_;
+};
+
+
+
+
+} // namespace Fogg
@@ -1,12 +1,26 @@
 
 #include "Converter.h"
 
-#include <QCoreApplication>
 #include <QThreadPool>
 #include <QMutexLocker>
 #include <QFileInfo>
 #include <QDir>
 #include <QThread>
+#include <QScopedPointer>
+#include <QTimer>
+#include <QCoreApplication>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <stdio.h>
+#endif
 
 #include <grim/audio/FormatPlugin.h>
 #include <grim/audio/FormatManager.h>
@@ -14,6 +28,13 @@
 #include <ogg/ogg.h>
 #include <vorbis/vorbisenc.h>
 
+#include "Deinterleaver.h"
+#include "EncoderSetupCache.h"
+#include "Resampler.h"
+#include "JobSegment.h"
+#include "JobDecoder.h"
+#include "ConversionManifest.h"
+
 
 
 
@@ -22,14 +43,40 @@ namespace Fogg {
 
 
 
-// emit progress each 1% and each 1 second
+// progress is reported with 1% granularity
 static const int kMaxProgress = 100;
 static const int kProgressInterval = 200;
 
+// jobs are polled often right after any of them has started or finished,
+// otherwise only at progress rate
+static const int kMinimumPollInterval = 50;
+
 // Vorbis tags
 static const QString kVorbisTagAlbum = QLatin1String( "ALBUM" );
 static const QString kVorbisTagDate  = QLatin1String( "DATE" );
 
+// splitting long files into segments, durations are in seconds
+static const int kMinimumSplitDuration    = 10*60;
+static const int kMinimumSegmentDuration  = 60;
+static const int kMaximumSegmentDuration  = 5*60;
+static const int kSegmentOverlapDuration  = 2;
+static const int kMaximumSpliceRetryCount = 2;
+
+// segments start at multiples of the largest Vorbis block size, in samples
+static const int kSegmentAlignment = 8192;
+
+// conversion manifest is saved while converting, so records of a long batch survive a crash or kill,
+// each save writes the whole manifest, so it is done at this interval in milliseconds rather than
+// per number of jobs, and once after the last job
+static const int kManifestSaveInterval = 60*1000;
+
+// mpg123 does not seek sample accurate, such files are never split
+static const QString kMp3FormatName = QLatin1String( "Mp3" );
+static const QString kVorbisFormatName = QLatin1String( "Ogg/Vorbis" );
+
+// makes temporary output file names unique within the process, job ids are reused
+static QAtomicInt temporaryFileCounter;
+
 
 
 
@@ -40,6 +87,18 @@ Converter::Converter( QObject * const parent ) :
 
 	concurrentThreadCount_ = 0;
 	jobThreadPool_ = new QThreadPool( this );
+
+	splitLongFiles_ = false;
+	syncOutputFiles_ = false;
+	segmentThreadPool_ = new QThreadPool( this );
+
+	conversionManifest_ = 0;
+	unsavedFinishedJobCount_ = 0;
+	manifestSaveTimer_.start();
+
+	pollTimer_ = new QTimer( this );
+	pollTimer_->setSingleShot( true );
+	connect( pollTimer_, SIGNAL(timeout()), SLOT(_pollJobs()) );
 }
 
 
@@ -51,45 +110,59 @@ void Converter::setConcurrentThreadCount( const int count )
 	concurrentThreadCount_ = count;
 	jobThreadPool_->setMaxThreadCount( concurrentThreadCount_ == 0 ?
 			QThread::idealThreadCount() : concurrentThreadCount_ );
+	segmentThreadPool_->setMaxThreadCount( jobThreadPool_->maxThreadCount() );
+}
+
+
+void Converter::setSplitLongFiles( const bool set )
+{
+	splitLongFiles_ = set;
+}
+
+
+void Converter::setSyncOutputFiles( const bool set )
+{
+	syncOutputFiles_ = set;
+}
+
+
+void Converter::setConversionManifest( ConversionManifest * const manifest )
+{
+	conversionManifest_ = manifest;
 }
 
 
 int Converter::addJob( const QString & sourceFilePath, const QString & format,
-		const QString & destinationFilePath, const qreal quality, const bool prependYearToAlbum )
+		const QString & destinationFilePath, const EncoderSettings & encoderSettings, const int sampleRate,
+		const bool prependYearToAlbum, const bool sourceMayChange )
 {
 	const int jobId = jobIdGenerator_.take();
 
-	Job * const job = new Job( this, jobId, sourceFilePath, format, destinationFilePath, quality, prependYearToAlbum );
+	Job * const job = new Job( this, jobId, sourceFilePath, format, destinationFilePath, encoderSettings, sampleRate,
+			prependYearToAlbum, sourceMayChange, splitLongFiles_ );
 	jobForId_[ jobId ] = job;
 
+	pendingJobCount_.ref();
 	jobThreadPool_->start( job );
 
+	_startPollTimer();
+
 	return jobId;
 }
 
 
 void Converter::abortJob( const int jobId )
 {
-	Job * const job = jobForId_.value( jobId );
+	Job * const job = jobForId_.take( jobId );
 	Q_ASSERT( job );
 	Q_ASSERT( !job->isAborted() );
 	Q_ASSERT( job->id() == jobId );
 
-	{
-		QWriteLocker locker( job->lock() );
-
-		job->abort();
+	job->abort();
 
-		if ( job->isStarted() )
-		{
-			// job is running, wait for finished event, then remove it
-		}
-		else
-		{
-			jobForId_.remove( job->id() );
-			jobIdGenerator_.free( job->id() );
-		}
-	}
+	// job is not reported anymore, delete it as soon as it leaves the thread pool
+	jobIdGenerator_.free( jobId );
+	abortedJobs_ << job;
 }
 
 
@@ -102,67 +175,173 @@ void Converter::abortAllJobs()
 
 void Converter::wait()
 {
-	// collect all finished events from jobs to wake them
-	while ( !jobForId_.isEmpty() )
+	// jobs never block on this thread, so thread pools can be waited directly,
+	// then remaining finished jobs are reported
+	while ( !jobForId_.isEmpty() || !abortedJobs_.isEmpty() )
 	{
-		QCoreApplication::sendPostedEvents( this, EventType_JobStarted );
-		QCoreApplication::sendPostedEvents( this, EventType_JobResolvedFormat );
-		QCoreApplication::sendPostedEvents( this, EventType_JobProgress );
-		QCoreApplication::sendPostedEvents( this, EventType_JobFinished );
+		jobThreadPool_->waitForDone();
+		segmentThreadPool_->waitForDone();
+		_pollJobs();
 	}
+}
 
-	// explicitly wait for thread pool
-	jobThreadPool_->waitForDone();
+
+void Converter::_startPollTimer()
+{
+	if ( !pollTimer_->isActive() )
+		pollTimer_->start( kMinimumPollInterval );
 }
 
 
-bool Converter::event( QEvent * const e )
+// Emits signals for everything changed in the job since the previous poll, in the order
+// they have happened, progress of running jobs is collected for a single batched emission.
+// Returns true if job has started or finished since that time.
+bool Converter::_reportJob( Job * const job, QVector<QPair<int,qreal> > & progress )
 {
-	switch ( e->type() )
+	const Job::State state = job->state();
+	const bool hasChangedState = state != job->reportedState_;
+
+	if ( state == Job::State_Queued )
+		return false;
+
+	if ( job->reportedState_ == Job::State_Queued )
+	{
+		job->reportedState_ = Job::State_Started;
+		emit jobStarted( job->id() );
+		if ( job->isAborted() )
+			return true;
+	}
+
+	if ( !job->isResolvedFormatReported_ && job->hasResolvedFormat_.loadAcquire() )
+	{
+		job->isResolvedFormatReported_ = true;
+		emit jobResolvedFormat( job->id(), job->resolvedFormat_ );
+		if ( job->isAborted() )
+			return true;
+	}
+
+	// progress is stored before the finished state, so the final progress is seen here
+	const int progressValue = job->progressValue_.loadAcquire();
+	if ( progressValue != job->reportedProgressValue_ )
 	{
-	case EventType_JobStarted:
-	case EventType_JobResolvedFormat:
-	case EventType_JobProgress:
-	case EventType_JobFinished:
-		const JobEvent * jobEvent = static_cast<JobEvent*>( e );
-		QWriteLocker jobLocker( jobEvent->job->lock() );
-		switch ( e->type() )
+		job->reportedProgressValue_ = progressValue;
+
+		if ( state == Job::State_Finished )
 		{
-		case EventType_JobStarted:
-			if ( !jobEvent->job->isAborted() )
-				emit jobStarted( jobEvent->job->id() );
-			break;
+			// finished job is deleted after this poll, so its final progress is emitted right away,
+			// before it is reported finished
+			emit jobsProgress( QVector<QPair<int,qreal> >() << qMakePair( job->id(), job->progress() ) );
+			if ( job->isAborted() )
+				return true;
+		}
+		else
+		{
+			progress << qMakePair( job->id(), job->progress() );
+		}
+	}
 
-		case EventType_JobResolvedFormat:
-			if ( !jobEvent->job->isAborted() )
-				emit jobResolvedFormat( jobEvent->job->id(), static_cast<const JobResolvedFormatEvent*>( jobEvent )->format );
-			break;
+	if ( state == Job::State_Finished )
+	{
+		job->reportedState_ = Job::State_Finished;
+		emit jobFinished( job->id(), job->result() );
+		return true;
+	}
 
-		case EventType_JobProgress:
-			if ( !jobEvent->job->isAborted() )
-				emit jobProgress( jobEvent->job->id(), jobEvent->job->progress() );
-			break;
+	return hasChangedState;
+}
 
-		case EventType_JobFinished:
-			if ( !jobEvent->job->isAborted() )
-				emit jobFinished( jobEvent->job->id(), jobEvent->job->result() );
 
-			jobForId_.remove( jobEvent->job->id() );
-			jobIdGenerator_.free( jobEvent->job->id() );
-			break;
+// Called from job threads.
+void Converter::_addStartedJob( Job * const job )
+{
+	QMutexLocker locker( &startedJobsMutex_ );
+	startedJobs_ << job;
+}
+
+
+void Converter::_takeStartedJobs()
+{
+	QMutexLocker locker( &startedJobsMutex_ );
+	activeJobs_ << startedJobs_;
+	startedJobs_.clear();
+}
+
+
+void Converter::_pollJobs()
+{
+	bool hasChangedState = false;
+	QVector<QPair<int,qreal> > progress;
+	QList<Job*> progressJobs;
+
+	_takeStartedJobs();
+
+	// slots connected to signals may add and abort jobs, aborted ones are not reported anymore
+	foreach ( Job * const job, activeJobs_ )
+	{
+		if ( job->isAborted() )
+			continue;
+
+		const int progressCount = progress.count();
+		if ( _reportJob( job, progress ) )
+			hasChangedState = true;
+		if ( progress.count() != progressCount )
+			progressJobs << job;
+
+		if ( job->reportedState_ == Job::State_Finished && !job->isAborted() )
+		{
+			unsavedFinishedJobCount_++;
+			activeJobs_.removeOne( job );
+			jobForId_.remove( job->id() );
+			jobIdGenerator_.free( job->id() );
+			delete job;
 		}
-		jobEvent->job->waiter()->wakeOne();
-		return true;
 	}
 
-	return QObject::event( e );
+	// jobs aborted by slots after their progress was collected are still owned by abortedJobs_
+	for ( int i = progressJobs.count() - 1; i >= 0; --i )
+		if ( progressJobs.at( i )->isAborted() )
+			progress.remove( i );
+
+	if ( !progress.isEmpty() )
+		emit jobsProgress( progress );
+
+	for ( QList<Job*>::iterator it = abortedJobs_.begin(); it != abortedJobs_.end(); )
+	{
+		Job * const job = *it;
+		if ( job->state() != Job::State_Finished )
+		{
+			++it;
+			continue;
+		}
+
+		// job might have started after started jobs were taken above, it is in the list by now
+		_takeStartedJobs();
+		activeJobs_.removeOne( job );
+
+		delete job;
+		it = abortedJobs_.erase( it );
+	}
+
+	if ( conversionManifest_ && unsavedFinishedJobCount_ > 0 &&
+			(jobForId_.isEmpty() || manifestSaveTimer_.hasExpired( kManifestSaveInterval )) )
+	{
+		conversionManifest_->saveInBackground();
+		unsavedFinishedJobCount_ = 0;
+		manifestSaveTimer_.restart();
+	}
+
+	if ( jobForId_.isEmpty() && abortedJobs_.isEmpty() )
+		return;
+
+	pollTimer_->start( hasChangedState ? kMinimumPollInterval : kProgressInterval );
 }
 
 
 
 
 Job::Job( Converter * const converter, const int id, const QString & sourceFilePath, const QString & format,
-		const QString & destinationFilePath, const qreal quality, const bool prependYearToAlbum )
+		const QString & destinationFilePath, const EncoderSettings & encoderSettings, const int sampleRate,
+		const bool prependYearToAlbum, const bool sourceMayChange, const bool splitIntoSegments )
 {
 	converter_ = converter;
 
@@ -171,52 +350,76 @@ Job::Job( Converter * const converter, const int id, const QString & sourceFileP
 	sourceFilePath_ = sourceFilePath;
 	format_ = format;
 	destinationFilePath_ = destinationFilePath;
-	quality_ = quality;
+	encoderSettings_ = encoderSettings;
+	sampleRate_ = sampleRate;
 	prependYearToAlbum_ = prependYearToAlbum;
+	sourceMayChange_ = sourceMayChange;
+	splitIntoSegments_ = splitIntoSegments;
+
+	setAutoDelete( false );
 
 	result_ = Converter::JobResult_Null;
-	isStarted_ = false;
-	isAborted_ = false;
 
-	progress_ = 0;
-	sentProgressValue_ = 0;
+	reportedState_ = State_Queued;
+	isResolvedFormatReported_ = false;
+	reportedProgressValue_ = 0;
 
 	sourceAudioFile_ = 0;
+	isVorbisChannelOrder_ = false;
+	resampler_ = 0;
+	resamplerInputSampleCount_ = 0;
+
+	pageWriter_.setDevice( &destinationFile_ );
+}
+
+
+qreal Job::progress() const
+{
+	return (qreal)progressValue_.loadAcquire() / kMaxProgress;
 }
 
 
 void Job::run()
 {
-	// send started event
+	converter_->pendingJobCount_.deref();
+
+	if ( isAborted() )
 	{
-		QWriteLocker locker( &lock_ );
-		if ( isAborted_ )
-		{
-			// do not emit finished event
-			return;
-		}
-		isStarted_ = true;
-		QCoreApplication::postEvent( converter_, new Converter::JobEvent( this, Converter::EventType_JobStarted ) );
-		waiter_.wait( &lock_ );
+		state_.storeRelease( State_Finished );
+		return;
 	}
 
+	// added before the state is published, so Converter sees started job in the list once it sees the state
+	converter_->_addStartedJob( this );
+	state_.storeRelease( State_Started );
+
 	result_ = _runBody();
 
-	// send finished event
+	// Abort coming after this check keeps complete destination file, it is recorded in manifest as well.
+	bool isFailed = isAborted() || (result_ != Converter::JobResult_Done && result_ != Converter::JobResult_UpToDate);
+
+	// output goes to a temporary file, which replaces destination only when complete,
+	// so neither failure nor crash leaves truncated file behind
+	if ( destinationFile_.isOpen() )
 	{
-		QWriteLocker locker( &lock_ );
-		QCoreApplication::postEvent( converter_, new Converter::JobEvent( this, Converter::EventType_JobFinished ) );
-		waiter_.wait( &lock_ );
+		if ( !isFailed && !_commitDestinationFile() )
+		{
+			foggWarning() << "Error saving destination file:" << destinationFilePath();
+			result_ = Converter::JobResult_WriteError;
+			isFailed = true;
+		}
+
+		if ( isFailed )
+		{
+			destinationFile_.close();
+			destinationFile_.remove();
+		}
 	}
 
-	// At this point all references to this Job instance are lost
-	// and we can safely use isAborted flag not only for quick exiting from _runBody(),
-	// but also for cleanup if conversion has been aborted.
-	if ( isAborted() || result_ != Converter::JobResult_Done )
+	if ( !isFailed && result_ == Converter::JobResult_Done && converter_->conversionManifest() )
 	{
-		if ( destinationFile_.isOpen() )
-			destinationFile_.close();
-		destinationFile_.remove();
+		converter_->conversionManifest()->update( sourceFilePath(), sourceState_, destinationFilePath(),
+				encoderSettings_, sampleRate_, prependYearToAlbum_ );
 	}
 
 	if ( sourceAudioFile_ )
@@ -224,50 +427,92 @@ void Job::run()
 		delete sourceAudioFile_;
 		sourceAudioFile_ = 0;
 	}
+
+	// Converter deletes this job once it sees the finished state, nothing can be touched after this
+	state_.storeRelease( State_Finished );
 }
 
-template<int channelCount, int bytesPerSample>
-static void _processSamples( const char * const rawData, float ** const vorbisData, const qint64 sampleCount )
+// Finds packets previousIndex and nextIndex, so the previous segment can be cut right after previousIndex
+// and continued with nextIndex from the next segment. Both segments must cover the same time
+// with the same block sizes around the cut, this way MDCT windows overlap exactly as in a single stream.
+static bool _findSplicePoint( const QList<JobSegment::Packet> & previousPackets, const QList<JobSegment::Packet> & nextPackets,
+		const int fromIndex, const qint64 fromSample, int & previousIndex, int & nextIndex )
 {
-	// Vorbis sample is a float value in range [-0.5 .. +0.5].
-	// This multiplier is for the 32 bit per sample source.
-	static const float kBppMultiplier = 2147483648.f;
+	QHash<qint64,int> nextIndexForGranulePosition;
+	for ( int i = 1; i < nextPackets.count(); ++i )
+	{
+		const JobSegment::Packet & packet = nextPackets.at( i - 1 );
+		if ( packet.granulePosition >= fromSample )
+			nextIndexForGranulePosition[ packet.granulePosition ] = i;
+	}
 
-	const int channelSampleSize = channelCount * bytesPerSample;
-	for ( int sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex )
+	for ( int i = fromIndex; i < previousPackets.count() - 1; ++i )
 	{
-		for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+		const JobSegment::Packet & previousPacket = previousPackets.at( i );
+		if ( previousPacket.granulePosition < fromSample )
+			continue;
+
+		const QHash<qint64,int>::const_iterator it = nextIndexForGranulePosition.constFind( previousPacket.granulePosition );
+		if ( it == nextIndexForGranulePosition.constEnd() )
+			continue;
+
+		const int j = it.value();
+		if ( previousPacket.blockSize == nextPackets.at( j - 1 ).blockSize &&
+				previousPackets.at( i + 1 ).blockSize == nextPackets.at( j ).blockSize )
 		{
-			const int sampleOffset = sampleIndex*channelSampleSize + channelIndex*bytesPerSample;
+			previousIndex = i;
+			nextIndex = j;
+			return true;
+		}
+	}
 
-			int value;
+	return false;
+}
 
-			switch ( bytesPerSample )
-			{
-			case 1:
-				value = *reinterpret_cast<const qint8*>( rawData + sampleOffset );
-				break;
-			case 2:
-				value = *reinterpret_cast<const qint16*>( rawData + sampleOffset );
-				break;
-			case 3:
-				value = 0;
-				for ( int i = 0; i < 3; ++i )
-					reinterpret_cast<char*>( &value )[ i ] = rawData[ sampleOffset + i ];
-				if ( value & (1 << 23) )
-					value |= 0xff000000;
-				break;
-			case 4:
-				value = *reinterpret_cast<const qint32*>( rawData + sampleOffset );
-				break;
-			default:
-				Q_ASSERT( false );
-			}
 
-			const float multiplier = kBppMultiplier / (1 << (4 - bytesPerSample)*8);
-			vorbisData[ channelIndex ][ sampleIndex ] = float(value) / multiplier;
-		}
+static qint64 _findLongBlockGranulePosition( const QList<JobSegment::Packet> & packets, const int longBlockSize,
+		const qint64 fromSample )
+{
+	for ( int i = 0; i < packets.count() - 1; ++i )
+	{
+		if ( packets.at( i ).granulePosition >= fromSample &&
+				packets.at( i ).blockSize == longBlockSize && packets.at( i + 1 ).blockSize == longBlockSize )
+			return packets.at( i ).granulePosition;
 	}
+
+	return -1;
+}
+
+
+// Evaluates how far the next segment start should be moved back,
+// so its long blocks fall onto the same grid as the previous segment ones.
+static bool _findSpliceShift( const QList<JobSegment::Packet> & previousPackets, const QList<JobSegment::Packet> & nextPackets,
+		const qint64 fromSample, qint64 & shift )
+{
+	int longBlockSize = 0;
+	foreach ( const JobSegment::Packet & packet, previousPackets )
+		longBlockSize = qMax( longBlockSize, packet.blockSize );
+
+	const qint64 previousGranulePosition = _findLongBlockGranulePosition( previousPackets, longBlockSize, fromSample );
+	const qint64 nextGranulePosition = _findLongBlockGranulePosition( nextPackets, longBlockSize, fromSample );
+	if ( previousGranulePosition == -1 || nextGranulePosition == -1 )
+		return false;
+
+	// sequential long blocks advance granule position by half of the block size
+	const qint64 step = longBlockSize / 2;
+	shift = (previousGranulePosition - nextGranulePosition) % step;
+	if ( shift > 0 )
+		shift -= step;
+
+	return shift != 0;
+}
+
+
+// Segments open source on their own, with the same flags.
+Grim::Audio::FormatFile * Job::_createSourceAudioFile() const
+{
+	return converter_->audioFormatManager()->createFormatFile( sourceFilePath(), format(),
+			sourceMayChange_ ? Grim::Audio::FormatFile::OpenFlag_MayChange : Grim::Audio::FormatFile::OpenFlags() );
 }
 
 
@@ -276,8 +521,19 @@ Converter::JobResultType Job::_runBody()
 	if ( isAborted() )
 		return Converter::JobResult_Null;
 
+	// checked here rather than in Converter::addJob() to keep file system access away from the caller thread
+	if ( converter_->conversionManifest() && converter_->conversionManifest()->isUpToDate(
+			sourceFilePath(), destinationFilePath(), encoderSettings_, sampleRate_, prependYearToAlbum_ ) )
+		return Converter::JobResult_UpToDate;
+
+	if ( converter_->conversionManifest() )
+		sourceState_ = ConversionManifest::sourceStateForFile( sourceFilePath() );
+
+	// hidden name in the same directory, so rename is atomic and players do not pick the file up
 	const QFileInfo destinationFileInfo = QFileInfo( destinationFilePath() );
-	destinationFile_.setFileName( destinationFilePath() );
+	destinationFile_.setFileName( destinationFileInfo.dir().absoluteFilePath(
+			QString::fromLatin1( ".%1.%2-%3.part" ).arg( destinationFileInfo.fileName() )
+			.arg( QCoreApplication::applicationPid() ).arg( temporaryFileCounter.fetchAndAddRelaxed( 1 ) ) ) );
 
 	static const int kOpenDestinationFileTryCount = 4;
 	static const int kOpenDestinationFileDelay = 500;
@@ -286,7 +542,9 @@ Converter::JobResultType Job::_runBody()
 	{
 		QDir().mkpath( destinationFileInfo.path() );
 
-		if ( destinationFile_.open( QIODevice::WriteOnly ) )
+		// temporary file name is unique, so retries are left for unwritable directories only;
+		// pages are written in big chunks by pageWriter_, no need to buffer them once again
+		if ( destinationFile_.open( QIODevice::WriteOnly | QIODevice::Unbuffered ) )
 			break;
 
 		foggWarning() << "Error opening destination file for write:" << destinationFilePath();
@@ -297,24 +555,25 @@ Converter::JobResultType Job::_runBody()
 	if ( !destinationFile_.isOpen() )
 		return Converter::JobResult_WriteError;
 
-	sourceAudioFile_ = converter_->audioFormatManager()->createFormatFile( sourceFilePath(), format() );
+	sourceAudioFile_ = _createSourceAudioFile();
 	if ( !sourceAudioFile_ )
 		return Converter::JobResult_NotSupported;
 
-	{
-		QWriteLocker locker( &lock_ );
-		QCoreApplication::postEvent( converter_,
-				new Converter::JobResolvedFormatEvent( this, sourceAudioFile_->resolvedFormat() ) );
-		waiter_.wait( &lock_ );
-	}
+	resolvedFormat_ = sourceAudioFile_->resolvedFormat();
+	hasResolvedFormat_.storeRelease( 1 );
 
 	const int channelCount = sourceAudioFile_->channels();
-	if ( channelCount != 1 && channelCount != 2 )
+	if ( channelCount < 1 || channelCount > Deinterleaver::kMaxChannelCount )
 	{
-		// only mono and stereo audio streams supported at this moment
+		// Vorbis defines channel order up to 7.1 only
 		return Converter::JobResult_NotSupported;
 	}
 
+	// other sources order surround channels as WAVE does
+	isVorbisChannelOrder_ = resolvedFormat_ == kVorbisFormatName;
+
+	_preallocateDestinationFile();
+
 	const int bitsPerSample = sourceAudioFile_->bitsPerSample();
 	switch ( bitsPerSample )
 	{
@@ -329,14 +588,13 @@ Converter::JobResultType Job::_runBody()
 		return Converter::JobResult_NotSupported;
 	}
 
-	vorbis_info vi;
-	vorbis_info_init( &vi );
+	// profile sample rate is applied by resampling source before encoder
+	const int encoderFrequency = sampleRate_ == 0 ? sourceAudioFile_->frequency() : sampleRate_;
 
-	if ( vorbis_encode_init_vbr( &vi, sourceAudioFile_->channels(), sourceAudioFile_->frequency(), quality_ ) )
-	{
-		vorbis_info_clear( &vi );
+	EncoderSetupCache::Setup * const encoderSetup = EncoderSetupCache::setupForCurrentThread(
+			encoderSettings_, sourceAudioFile_->channels(), encoderFrequency );
+	if ( !encoderSetup )
 		return Converter::JobResult_ConvertError;
-	}
 
 	// save original tags
 	vorbis_comment vc;
@@ -359,7 +617,7 @@ Converter::JobResultType Job::_runBody()
 	}
 
 	vorbis_dsp_state vd;
-	vorbis_analysis_init( &vd, &vi );
+	vorbis_analysis_init( &vd, encoderSetup->info() );
 
 	vorbis_block vb;
 	vorbis_block_init( &vd, &vb );
@@ -371,7 +629,7 @@ Converter::JobResultType Job::_runBody()
 	ogg_stream_init( &os, 1 );
 
 	ogg_packet header, header_comm, header_code;
-	vorbis_analysis_headerout( &vd, &vc, &header, &header_comm, &header_code );
+	encoderSetup->headerOut( &vd, &vc, &header, &header_comm, &header_code );
 	ogg_stream_packetin( &os, &header );
 	ogg_stream_packetin( &os, &header_comm );
 	ogg_stream_packetin( &os, &header_code );
@@ -386,15 +644,42 @@ Converter::JobResultType Job::_runBody()
 		int result = ogg_stream_flush( &os, &og );
 		if ( result == 0 )
 			break;
-		if ( destinationFile_.write( (const char *)og.header, og.header_len ) != og.header_len )
+		if ( !pageWriter_.write( og ) )
 		{
 			writeError = true;
 			break;
 		}
-		if ( destinationFile_.write( (const char *)og.body, og.body_len ) != og.body_len )
+	}
+
+	bool isEncoded = false;
+
+	if ( !writeError && splitIntoSegments_ && _canSplitIntoSegments() )
+	{
+		isEncoded = _runSegmentedBody( &os, writeError );
+
+		if ( !isEncoded )
 		{
-			writeError = true;
-			break;
+			// segments could not be spliced seamlessly, start over and encode the whole file sequentially
+			ogg_stream_clear( &os );
+			ogg_stream_init( &os, 1 );
+
+			ogg_stream_packetin( &os, &header );
+			ogg_stream_packetin( &os, &header_comm );
+			ogg_stream_packetin( &os, &header_code );
+
+			pageWriter_.discard();
+			if ( !destinationFile_.resize( 0 ) || !destinationFile_.seek( 0 ) )
+				writeError = true;
+			else
+				_preallocateDestinationFile();
+
+			while ( !writeError && ogg_stream_flush( &os, &og ) )
+			{
+				if ( !pageWriter_.write( og ) )
+					writeError = true;
+			}
+
+			_setProgress( 0 );
 		}
 	}
 
@@ -402,60 +687,117 @@ Converter::JobResultType Job::_runBody()
 
 	const int channelSampleSize = sourceAudioFile_->samplesToBytes( 1 );
 
+	const Deinterleaver::Kernel deinterleave = Deinterleaver::kernel( channelCount, bitsPerSample );
+
 	QByteArray sourceBuffer;
 	sourceBuffer.resize( sourceAudioFile_->samplesToBytes( kSampleCount ) );
 	const char * const sourceBufferData = sourceBuffer.constData();
 
-	if ( !writeError )
+	QScopedPointer<JobDecoder> decoder;
+
+	if ( !writeError && !isEncoded && encoderFrequency != sourceAudioFile_->frequency() )
+	{
+		resampler_ = new Resampler( channelCount, sourceAudioFile_->frequency(), encoderFrequency );
+		resamplerInputSampleCount_ = kSampleCount;
+		resamplerInput_.resize( channelCount*resamplerInputSampleCount_ );
+	}
+
+	if ( !writeError && !isEncoded && _canDecodeInParallel() )
+	{
+		decoder.reset( new JobDecoder( sourceAudioFile_, kSampleCount ) );
+		decoder->start();
+	}
+
+	if ( !writeError && !isEncoded )
 	{
 		while ( !eos )
 		{
-			const qint64 bytes = sourceAudioFile_->device()->read( sourceBuffer.data(), sourceBuffer.size() );
+			qint64 sourcePosition;
 
-			if ( bytes == -1 )
+			if ( decoder )
 			{
-				readError = true;
-				break;
-			}
+				const JobDecoder::Block & block = decoder->acquireBlock();
+
+				if ( block.sampleCount == -1 )
+				{
+					readError = true;
+					break;
+				}
+
+				if ( block.sampleCount == 0 )
+				{
+					_sourceWrote( &vd, 0 );
+				}
+				else
+				{
+					// samples are already uninterleaved by decoder
+					float * channelData[ Deinterleaver::kMaxChannelCount ];
+					_sourceBuffer( &vd, block.sampleCount, channelData );
+
+					for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+						memcpy( channelData[ channelIndex ], block.samples.constData() + channelIndex*decoder->blockSampleCount(),
+								block.sampleCount * sizeof(float) );
 
-			if ( bytes == 0 )
+					_sourceWrote( &vd, block.sampleCount );
+				}
+
+				sourcePosition = block.sourcePosition;
+
+				decoder->releaseBlock();
+			}
+			else if ( sourceAudioFile_->canReadFloat() )
 			{
-				vorbis_analysis_wrote( &vd, 0 );
+				// float decoders write straight into encoder buffers
+				float * channelData[ Deinterleaver::kMaxChannelCount ];
+				_sourceBuffer( &vd, kSampleCount, channelData );
+				const qint64 sampleCount = sourceAudioFile_->readFloat( channelData, kSampleCount );
+
+				if ( sampleCount == -1 )
+				{
+					readError = true;
+					break;
+				}
+
+				_sourceWrote( &vd, int(sampleCount) );
+
+				sourcePosition = sourceAudioFile_->device()->pos();
 			}
 			else
 			{
-				const int sampleCount = sourceAudioFile_->bytesToSamples( bytes );
+				// mapped PCM sources are deinterleaved in place, others are read into buffer
+				qint64 bytes;
+				const char * sourceData = sourceAudioFile_->readView( sourceBuffer.size(), bytes );
+				if ( !sourceData && bytes != -1 )
+				{
+					bytes = sourceAudioFile_->device()->read( sourceBuffer.data(), sourceBuffer.size() );
+					sourceData = sourceBufferData;
+				}
 
-				// uninterleave samples
-				float ** const vorbisData = vorbis_analysis_buffer( &vd, sampleCount );
+				if ( bytes == -1 )
+				{
+					readError = true;
+					break;
+				}
 
-				if ( channelCount == 1 )
+				if ( bytes == 0 )
 				{
-					switch ( bitsPerSample )
-					{
-					case  8: _processSamples<1,1>( sourceBufferData, vorbisData, sampleCount ); break;
-					case 16: _processSamples<1,2>( sourceBufferData, vorbisData, sampleCount ); break;
-					case 24: _processSamples<1,3>( sourceBufferData, vorbisData, sampleCount ); break;
-					case 32: _processSamples<1,4>( sourceBufferData, vorbisData, sampleCount ); break;
-					default:
-						Q_ASSERT( false );
-					}
+					_sourceWrote( &vd, 0 );
 				}
 				else
 				{
-					switch ( bitsPerSample )
-					{
-					case  8: _processSamples<2,1>( sourceBufferData, vorbisData, sampleCount ); break;
-					case 16: _processSamples<2,2>( sourceBufferData, vorbisData, sampleCount ); break;
-					case 24: _processSamples<2,3>( sourceBufferData, vorbisData, sampleCount ); break;
-					case 32: _processSamples<2,4>( sourceBufferData, vorbisData, sampleCount ); break;
-					default:
-						Q_ASSERT( false );
-					}
+					const int sampleCount = sourceAudioFile_->bytesToSamples( bytes );
+
+					// uninterleave samples
+					float * channelData[ Deinterleaver::kMaxChannelCount ];
+					_sourceBuffer( &vd, sampleCount, channelData );
+
+					deinterleave( sourceData, channelData, sampleCount, channelCount );
+
+					// tell the library how much we actually submitted
+					_sourceWrote( &vd, sampleCount );
 				}
 
-				// tell the library how much we actually submitted
-				vorbis_analysis_wrote( &vd, sampleCount );
+				sourcePosition = sourceAudioFile_->device()->pos();
 			}
 
 			while ( vorbis_analysis_blockout( &vd, &vb ) == 1 )
@@ -476,12 +818,7 @@ Converter::JobResultType Job::_runBody()
 						if ( result == 0 )
 							break;
 
-						if ( destinationFile_.write( (const char *)og.header, og.header_len ) != og.header_len )
-						{
-							writeError = true;
-							break;
-						}
-						if ( destinationFile_.write( (const char *)og.body, og.body_len ) != og.body_len )
+						if ( !pageWriter_.write( og ) )
 						{
 							writeError = true;
 							break;
@@ -491,50 +828,45 @@ Converter::JobResultType Job::_runBody()
 							eos = 1;
 					}
 
-					if ( writeError || isAborted_ )
+					if ( writeError || isAborted() )
 						break;
 				}
 
-				if ( writeError || isAborted_ )
+				if ( writeError || isAborted() )
 					break;
 			}
 
-			if ( writeError || isAborted_ )
+			if ( writeError || isAborted() )
 				break;
 
 			// calculate progress
-			progress_ = (qreal)sourceAudioFile_->bytesToSamples( sourceAudioFile_->device()->pos() ) /
-				sourceAudioFile_->totalSamples();
-
-			const int currentProgressValue = qBound( 0, static_cast<int>( progress_*kMaxProgress ), kMaxProgress );
-			if ( currentProgressValue > sentProgressValue_ )
-			{
-				const QTime currentTime = QTime::currentTime();
-				const int timeAfterPreviousSent = sentProgressTime_.msecsTo( currentTime );
-				if ( timeAfterPreviousSent >= kProgressInterval )
-				{
-					sentProgressTime_ = currentTime;
-					sentProgressValue_ = currentProgressValue;
-
-					{
-						QWriteLocker locker( &lock_ );
-						QCoreApplication::postEvent( converter_,
-							new Converter::JobEvent( this, Converter::EventType_JobProgress) );
-						waiter_.wait( &lock_ );
-					}
-				}
-			}
+			_setProgress( (qreal)sourceAudioFile_->bytesToSamples( sourcePosition ) /
+				sourceAudioFile_->totalSamples() );
 		}
 	}
 
+	// stop decoder before source file is closed
+	decoder.reset();
+
+	delete resampler_;
+	resampler_ = 0;
+	resamplerInput_ = QVector<float>();
+
 	// cleanup
 	ogg_stream_clear( &os );
 	vorbis_block_clear( &vb );
 	vorbis_dsp_clear( &vd );
 	vorbis_comment_clear( &vc );
-	vorbis_info_clear( &vi );
+	ogg_packet_clear( &header_comm );
 
-	destinationFile_.close();
+	// output of failed or aborted job is discarded anyway
+	if ( !readError && !writeError && !isAborted() )
+	{
+		// cut off preallocated space that was not used
+		if ( !pageWriter_.flush() || !destinationFile_.resize( destinationFile_.pos() ) )
+			writeError = true;
+	}
+	pageWriter_.discard();
 
 	if ( readError )
 		return Converter::JobResult_ReadError;
@@ -546,6 +878,340 @@ Converter::JobResultType Job::_runBody()
 }
 
 
+void Job::_setProgress( const qreal progress )
+{
+	progressValue_.storeRelease( qBound( 0, static_cast<int>( progress*kMaxProgress ), kMaxProgress ) );
+}
+
+
+// Reserves space for the expected output, so destination does not fragment while growing page by page.
+void Job::_preallocateDestinationFile()
+{
+#ifdef Q_OS_LINUX
+	const qint64 totalSamples = sourceAudioFile_->totalSamples();
+	if ( totalSamples <= 0 )
+		return;
+
+	// it is fine to miss a bit, bitrate in quality mode is known approximately only
+	const qint64 bytesPerSecond = qint64(encoderSettings_.expectedBitrate()) * 1000/8 * sourceAudioFile_->channels()/2;
+	const qint64 size = qMax<qint64>( bytesPerSecond, totalSamples * bytesPerSecond / sourceAudioFile_->frequency() );
+
+	// unlike posix_fallocate() this fails instead of writing zeros on file systems without support,
+	// file just grows as written then
+	fallocate( destinationFile_.handle(), 0, 0, size );
+#endif
+}
+
+
+// Syncs output if asked for, then replaces destination with it.
+bool Job::_commitDestinationFile()
+{
+	if ( converter_->syncOutputFiles() )
+	{
+#if defined Q_OS_WIN
+		const int syncResult = _commit( destinationFile_.handle() );
+#elif defined Q_OS_LINUX
+		const int syncResult = fdatasync( destinationFile_.handle() );
+#else
+		const int syncResult = fsync( destinationFile_.handle() );
+#endif
+		if ( syncResult != 0 )
+			return false;
+	}
+
+	destinationFile_.close();
+	if ( destinationFile_.error() != QFileDevice::NoError )
+		return false;
+
+	// QFile::rename() does not replace existing files
+#ifdef Q_OS_WIN
+	return MoveFileExW( reinterpret_cast<const wchar_t*>( QDir::toNativeSeparators( destinationFile_.fileName() ).utf16() ),
+			reinterpret_cast<const wchar_t*>( QDir::toNativeSeparators( destinationFilePath() ).utf16() ),
+			MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+	return ::rename( QFile::encodeName( destinationFile_.fileName() ).constData(),
+			QFile::encodeName( destinationFilePath() ).constData() ) == 0;
+#endif
+}
+
+
+// Decoding in a separate thread pays off only when there are idle cores,
+// i.e. no more jobs are waiting in queue and running ones do not occupy all cores.
+bool Job::_canDecodeInParallel() const
+{
+	return converter_->pendingJobCount_.load() == 0 &&
+			converter_->jobThreadPool_->activeThreadCount() < QThread::idealThreadCount();
+}
+
+
+// Points channels to Vorbis encoder buffers in the source channel order.
+void Job::_mapChannels( float * const * const vorbisData, float ** const channels ) const
+{
+	const int channelCount = sourceAudioFile_->channels();
+
+	if ( isVorbisChannelOrder_ )
+	{
+		for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+			channels[ channelIndex ] = vorbisData[ channelIndex ];
+		return;
+	}
+
+	Deinterleaver::mapChannels( vorbisData, channelCount, channels );
+}
+
+
+// Points channels to where the next sampleCount source samples go, in source channel order:
+// either encoder buffers or resampler input, which is kept in Vorbis channel order.
+void Job::_sourceBuffer( vorbis_dsp_state * const vd, const int sampleCount, float ** const channels )
+{
+	if ( !resampler_ )
+	{
+		_mapChannels( vorbis_analysis_buffer( vd, sampleCount ), channels );
+		return;
+	}
+
+	Q_ASSERT( sampleCount <= resamplerInputSampleCount_ );
+
+	float * inputData[ Deinterleaver::kMaxChannelCount ];
+	for ( int channelIndex = 0; channelIndex < resampler_->channelCount(); ++channelIndex )
+		inputData[ channelIndex ] = resamplerInput_.data() + channelIndex*resamplerInputSampleCount_;
+
+	_mapChannels( inputData, channels );
+}
+
+
+// Submits sampleCount samples written thru _sourceBuffer() to encoder, 0 means end of source.
+void Job::_sourceWrote( vorbis_dsp_state * const vd, const int sampleCount )
+{
+	if ( !resampler_ )
+	{
+		vorbis_analysis_wrote( vd, sampleCount );
+		return;
+	}
+
+	if ( sampleCount > 0 )
+	{
+		const float * inputData[ Deinterleaver::kMaxChannelCount ];
+		for ( int channelIndex = 0; channelIndex < resampler_->channelCount(); ++channelIndex )
+			inputData[ channelIndex ] = resamplerInput_.constData() + channelIndex*resamplerInputSampleCount_;
+
+		// filter needs a few samples ahead, so the very first blocks may produce nothing,
+		// encoder must not see zero count then as it means end of stream
+		const int outputSampleCount = resampler_->outputSampleCount( sampleCount );
+		if ( outputSampleCount == 0 )
+		{
+			resampler_->process( inputData, sampleCount, 0 );
+			return;
+		}
+
+		resampler_->process( inputData, sampleCount, vorbis_analysis_buffer( vd, outputSampleCount ) );
+		vorbis_analysis_wrote( vd, outputSampleCount );
+		return;
+	}
+
+	const int tailSampleCount = resampler_->tailSampleCount();
+	if ( tailSampleCount > 0 )
+	{
+		resampler_->flush( vorbis_analysis_buffer( vd, tailSampleCount ) );
+		vorbis_analysis_wrote( vd, tailSampleCount );
+	}
+
+	vorbis_analysis_wrote( vd, 0 );
+}
+
+
+bool Job::_canSplitIntoSegments() const
+{
+	// each segment seeks through its own instance of the source file
+	if ( sourceAudioFile_->device()->isSequential() )
+		return false;
+
+	if ( sourceAudioFile_->resolvedFormat() == kMp3FormatName )
+		return false;
+
+	// segments are split and spliced in source samples, resampled stream has other granule positions
+	if ( sampleRate_ != 0 && sampleRate_ != sourceAudioFile_->frequency() )
+		return false;
+
+	// bit reservoir state does not carry over splices, so bitrate bounds would not hold around them
+	if ( encoderSettings_.isManaged() )
+		return false;
+
+	return sourceAudioFile_->totalSamples() >= qint64(kMinimumSplitDuration) * sourceAudioFile_->frequency();
+}
+
+
+// Returns false if segments could not be spliced, in this case output should be encoded from scratch.
+bool Job::_runSegmentedBody( ogg_stream_state * const os, bool & writeError )
+{
+	QThreadPool * const segmentThreadPool = converter_->segmentThreadPool_;
+
+	const qint64 totalSamples = sourceAudioFile_->totalSamples();
+	const qint64 frequency = sourceAudioFile_->frequency();
+	const qint64 overlap = kSegmentOverlapDuration * frequency;
+
+	const qint64 segmentLength = qBound( kMinimumSegmentDuration * frequency,
+			totalSamples / segmentThreadPool->maxThreadCount(), kMaximumSegmentDuration * frequency );
+	const int segmentCount = int(totalSamples / segmentLength);
+	if ( segmentCount < 2 )
+		return false;
+
+	QList<qint64> boundaries;
+	for ( int i = 0; i < segmentCount; ++i )
+		boundaries << i*segmentLength;
+
+	// Segments overlap, so the next segment encoder has time to come to the same decisions
+	// as the previous one before the splice point.
+	QList<JobSegment*> segments;
+	for ( int i = 0; i < segmentCount; ++i )
+	{
+		const bool isLast = i == segmentCount - 1;
+		const qint64 startSample = i == 0 ? 0 : (boundaries.at( i ) - overlap) / kSegmentAlignment * kSegmentAlignment;
+		const qint64 endSample = isLast ? totalSamples : boundaries.at( i + 1 ) + overlap;
+
+		JobSegment * const segment = new JobSegment( this, startSample, endSample, isLast );
+		segments << segment;
+		segmentThreadPool->start( segment );
+	}
+
+	bool isSpliced = true;
+	int firstPacketIndex = 0;
+
+	for ( int i = 0; i < segments.count(); ++i )
+	{
+		JobSegment * const segment = segments.at( i );
+
+		_waitForSegment( segment, segments );
+		if ( isAborted() )
+			break;
+
+		if ( segment->result() != Converter::JobResult_Done )
+		{
+			isSpliced = false;
+			break;
+		}
+
+		if ( segment->isLast() )
+		{
+			if ( !_writeSegmentPackets( os, segment, firstPacketIndex, segment->packets().count() - 1 ) )
+				writeError = true;
+			break;
+		}
+
+		JobSegment * const nextSegment = segments.at( i + 1 );
+
+		_waitForSegment( nextSegment, segments );
+		if ( isAborted() )
+			break;
+
+		const qint64 spliceFromSample = boundaries.at( i + 1 ) - overlap/2;
+
+		int previousIndex = -1;
+		int nextIndex = -1;
+		bool isFound = nextSegment->result() == Converter::JobResult_Done &&
+				_findSplicePoint( segment->packets(), nextSegment->packets(), firstPacketIndex, spliceFromSample,
+					previousIndex, nextIndex );
+
+		// block grids of both segments may not match, encode the next segment again with shifted start
+		for ( int retry = 0; !isFound && retry < kMaximumSpliceRetryCount; ++retry )
+		{
+			qint64 shift;
+			if ( nextSegment->result() != Converter::JobResult_Done ||
+					!_findSpliceShift( segment->packets(), nextSegment->packets(), spliceFromSample, shift ) )
+				break;
+
+			nextSegment->restart( nextSegment->startSample() + shift );
+			nextSegment->run();
+
+			isFound = nextSegment->result() == Converter::JobResult_Done &&
+					_findSplicePoint( segment->packets(), nextSegment->packets(), firstPacketIndex, spliceFromSample,
+						previousIndex, nextIndex );
+		}
+
+		if ( isAborted() )
+			break;
+
+		if ( !isFound )
+		{
+			isSpliced = false;
+			break;
+		}
+
+		if ( !_writeSegmentPackets( os, segment, firstPacketIndex, previousIndex ) )
+		{
+			writeError = true;
+			break;
+		}
+
+		segment->clearPackets();
+		firstPacketIndex = nextIndex;
+	}
+
+	foreach ( JobSegment * const segment, segments )
+	{
+		segment->abort();
+		while ( !segment->waitForFinished() )
+			;
+	}
+	qDeleteAll( segments );
+
+	return isSpliced || isAborted() || writeError;
+}
+
+
+void Job::_waitForSegment( JobSegment * const segment, const QList<JobSegment*> & segments )
+{
+	while ( !segment->waitForFinished( kProgressInterval ) )
+	{
+		if ( isAborted() )
+		{
+			foreach ( JobSegment * const otherSegment, segments )
+				otherSegment->abort();
+			continue;
+		}
+
+		qint64 processedSamples = 0;
+		qint64 totalSamples = 0;
+		foreach ( const JobSegment * const otherSegment, segments )
+		{
+			processedSamples += otherSegment->processedSamples();
+			totalSamples += otherSegment->endSample() - otherSegment->startSample();
+		}
+
+		_setProgress( (qreal)processedSamples / totalSamples );
+	}
+}
+
+
+bool Job::_writeSegmentPackets( ogg_stream_state * const os, const JobSegment * const segment,
+		const int fromIndex, const int toIndex )
+{
+	for ( int i = fromIndex; i <= toIndex; ++i )
+	{
+		const JobSegment::Packet & packet = segment->packets().at( i );
+
+		ogg_packet op;
+		op.packet = reinterpret_cast<unsigned char*>( const_cast<char*>( packet.data.constData() ) );
+		op.bytes = packet.data.size();
+		op.b_o_s = 0;
+		op.e_o_s = packet.isEndOfStream ? 1 : 0;
+		op.granulepos = packet.granulePosition;
+		op.packetno = os->packetno;
+
+		ogg_stream_packetin( os, &op );
+
+		ogg_page og;
+		while ( ogg_stream_pageout( os, &og ) )
+		{
+			if ( !pageWriter_.write( og ) )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
 QString Job::_findDateTag( const QMultiMap<QString,QString> & tags ) const
 {
 	if ( !prependYearToAlbum_ )
@@ -564,7 +1230,7 @@ QString Job::_findDateTag( const QMultiMap<QString,QString> & tags ) const
 
 void Job::abort()
 {
-	isAborted_ = true;
+	isAborted_.storeRelease( 1 );
 }
 
 
@@ -2,22 +2,31 @@
 #pragma once
 
 #include <QObject>
-#include <QEvent>
-#include <QReadWriteLock>
-#include <QWaitCondition>
 #include <QHash>
+#include <QList>
+#include <QVector>
+#include <QPair>
 #include <QRunnable>
 #include <QFile>
-#include <QTime>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QElapsedTimer>
 
 #include <grim/tools/IdGenerator.h>
 
+#include <ogg/ogg.h>
+#include <vorbis/codec.h>
+
 #include "Global.h"
+#include "EncoderSettings.h"
+#include "OggPageWriter.h"
+#include "ConversionManifest.h"
 
 
 
 
 class QThreadPool;
+class QTimer;
 
 namespace Grim {
 namespace Audio {
@@ -35,6 +44,8 @@ namespace Fogg {
 
 
 class Job;
+class JobSegment;
+class Resampler;
 
 
 
@@ -51,7 +62,8 @@ public:
 		JobResult_ReadError    = 2,
 		JobResult_NotSupported = 3,
 		JobResult_ConvertError = 4,
-		JobResult_WriteError   = 5
+		JobResult_WriteError   = 5,
+		JobResult_UpToDate     = 6
 	};
 
 	Converter( QObject * parent = 0 );
@@ -60,8 +72,22 @@ public:
 
 	void setConcurrentThreadCount( int count );
 
+	bool splitLongFiles() const;
+	void setSplitLongFiles( bool set );
+
+	// Flushes each output file to disk before it replaces destination. Off by default,
+	// since syncing every file slows big batches down, especially on USB drives.
+	bool syncOutputFiles() const;
+	void setSyncOutputFiles( bool set );
+
+	ConversionManifest * conversionManifest() const;
+	void setConversionManifest( ConversionManifest * manifest );
+
+	// sourceMayChange tells source might be rewritten by others while converting, e.g. a watched file,
+	// it is read rather than memory mapped then
 	int addJob( const QString & sourceFilePath, const QString & format,
-			const QString & destinationFilePath, qreal quality, bool prependYearToAlbum );
+			const QString & destinationFilePath, const EncoderSettings & encoderSettings, int sampleRate,
+			bool prependYearToAlbum, bool sourceMayChange );
 	void abortJob( int jobId );
 	void abortAllJobs();
 	void wait();
@@ -69,61 +95,66 @@ public:
 signals:
 	void jobStarted( int jobId );
 	void jobResolvedFormat( int jobId, const QString & format );
-	void jobProgress( int jobId, qreal progress );
+	// progress of all jobs changed since previous emission, as pairs of job id and progress
+	void jobsProgress( const QVector<QPair<int,qreal> > & progress );
 	void jobFinished( int jobId, int result );
 
-protected:
-	bool event( QEvent * e );
-
 private:
-	enum EventType
-	{
-		EventType_JobStarted = QEvent::User + 1,
-		EventType_JobResolvedFormat,
-		EventType_JobProgress,
-		EventType_JobFinished
-	};
+	bool _reportJob( Job * job, QVector<QPair<int,qreal> > & progress );
+	void _addStartedJob( Job * job );
+	void _takeStartedJobs();
+	void _startPollTimer();
 
-	class JobEvent : public QEvent
-	{
-	public:
-		JobEvent( Job * const _job, const EventType eventType ) :
-			QEvent( QEvent::Type(eventType) ),
-			job( _job )
-		{}
-
-		Job * const job;
-	};
-
-	class JobResolvedFormatEvent : public JobEvent
-	{
-	public:
-		JobResolvedFormatEvent( Job * const job, const QString & _format ) :
-			JobEvent( job, EventType_JobResolvedFormat ),
-			format( _format )
-		{}
-
-		QString format;
-	};
+private slots:
+	void _pollJobs();
 
 private:
 	Grim::Audio::FormatManager * audioFormatManager_;
 
 	int concurrentThreadCount_;
 	QThreadPool * jobThreadPool_;
+	QAtomicInt pendingJobCount_;
+
+	bool splitLongFiles_;
+	bool syncOutputFiles_;
+	QThreadPool * segmentThreadPool_;
+
+	ConversionManifest * conversionManifest_;
+	int unsavedFinishedJobCount_;
+	QElapsedTimer manifestSaveTimer_;
 
 	Grim::Tools::IdGenerator jobIdGenerator_;
 	QHash<int,Job*> jobForId_;
 
+	// aborted jobs are not reported anymore, but still owned until they finish running
+	QList<Job*> abortedJobs_;
+
+	// Jobs add themselves to startedJobs_ from their threads when they start running,
+	// Converter moves them to activeJobs_ and polls those only, queued jobs are left alone.
+	QMutex startedJobsMutex_;
+	QList<Job*> startedJobs_;
+	QList<Job*> activeJobs_;
+
+	QTimer * pollTimer_;
+
 	friend class Job;
 };
 
 
 
 
+// Jobs never wait for the Converter thread, they publish their status atomically
+// and Converter polls started ones on a single timer.
 class Job : public QRunnable
 {
 public:
+	enum State
+	{
+		State_Queued   = 0,
+		State_Started  = 1,
+		State_Finished = 2
+	};
+
 	int id() const;
 
 	QString sourceFilePath() const;
@@ -131,12 +162,9 @@ public:
 	QString destinationFilePath() const;
 	Converter::JobResultType result() const;
 
-	QReadWriteLock * lock() const;
-	QWaitCondition * waiter() const;
-
+	State state() const;
 	qreal progress() const;
 
-	bool isStarted() const;
 	bool isAborted() const;
 
 	void abort();
@@ -147,10 +175,27 @@ protected:
 
 private:
 	Job( Converter * converter, int id, const QString & sourceFilePath, const QString & format,
-			const QString & destinationFilePath, qreal quality, bool prependYearToAlbum );
+			const QString & destinationFilePath, const EncoderSettings & encoderSettings, int sampleRate,
+			bool prependYearToAlbum, bool sourceMayChange, bool splitIntoSegments );
 
+	Grim::Audio::FormatFile * _createSourceAudioFile() const;
 	Converter::JobResultType _runBody();
 	QString _findDateTag( const QMultiMap<QString,QString> & tags ) const;
+	void _setProgress( qreal progress );
+	void _preallocateDestinationFile();
+	bool _commitDestinationFile();
+
+	bool _canDecodeInParallel() const;
+
+	void _mapChannels( float * const * vorbisData, float ** channels ) const;
+
+	void _sourceBuffer( vorbis_dsp_state * vd, int sampleCount, float ** channels );
+	void _sourceWrote( vorbis_dsp_state * vd, int sampleCount );
+
+	bool _canSplitIntoSegments() const;
+	bool _runSegmentedBody( ogg_stream_state * os, bool & writeError );
+	void _waitForSegment( JobSegment * segment, const QList<JobSegment*> & segments );
+	bool _writeSegmentPackets( ogg_stream_state * os, const JobSegment * segment, int fromIndex, int toIndex );
 
 private:
 	Converter * converter_;
@@ -160,24 +205,37 @@ private:
 	QString sourceFilePath_;
 	QString format_;
 	QString destinationFilePath_;
-	qreal quality_;
+	EncoderSettings encoderSettings_;
+	int sampleRate_;
 	bool prependYearToAlbum_;
+	bool sourceMayChange_;
+	bool splitIntoSegments_;
 
+	// written by job thread, result_ and resolvedFormat_ are published by releasing state_ and hasResolvedFormat_
 	Converter::JobResultType result_;
-	bool isStarted_;
-	bool isAborted_;
-
-	mutable QReadWriteLock lock_;
-	mutable QWaitCondition waiter_;
-
+	QString resolvedFormat_;
+	QAtomicInt state_;
+	QAtomicInt hasResolvedFormat_;
+	QAtomicInt progressValue_;
+	QAtomicInt isAborted_;
+
+	// touched by Converter thread only
+	State reportedState_;
+	bool isResolvedFormatReported_;
+	int reportedProgressValue_;
+
+	ConversionManifest::SourceState sourceState_;
 	Grim::Audio::FormatFile * sourceAudioFile_;
+	bool isVorbisChannelOrder_;
+	Resampler * resampler_;
+	QVector<float> resamplerInput_;
+	int resamplerInputSampleCount_;
+	// output goes to a sibling temporary file renamed to destination when complete
 	QFile destinationFile_;
-
-	qreal progress_;
-	QTime sentProgressTime_;
-	int sentProgressValue_;
+	OggPageWriter pageWriter_;
 
 	friend class Converter;
+	friend class JobSegment;
 };
 
 
@@ -186,6 +244,15 @@ private:
 inline Grim::Audio::FormatManager * Converter::audioFormatManager() const
 { return audioFormatManager_; }
 
+inline bool Converter::splitLongFiles() const
+{ return splitLongFiles_; }
+
+inline bool Converter::syncOutputFiles() const
+{ return syncOutputFiles_; }
+
+inline ConversionManifest * Converter::conversionManifest() const
+{ return conversionManifest_; }
+
 
 
 
@@ -204,20 +271,11 @@ inline QString Job::destinationFilePath() const
 inline Converter::JobResultType Job::result() const
 { return result_; }
 
-inline QReadWriteLock * Job::lock() const
-{ return &lock_; }
-
-inline QWaitCondition * Job::waiter() const
-{ return &waiter_; }
-
-inline qreal Job::progress() const
-{ return progress_; }
-
-inline bool Job::isStarted() const
-{ return isStarted_; }
+inline Job::State Job::state() const
+{ return State(state_.loadAcquire()); }
 
 inline bool Job::isAborted() const
-{ return isAborted_; }
+{ return isAborted_.loadAcquire() != 0; }
 
 
 
@@ -0,0 +1,648 @@
+
+#include "Deinterleaver.h"
+
+#include <QByteArray>
+
+#if defined(Q_PROCESSOR_X86) && defined(Q_CC_GNU)
+#	define FOGG_DEINTERLEAVER_X86
+#	include <immintrin.h>
+#	define FOGG_TARGET_SSE2 __attribute__((target("sse2")))
+#	define FOGG_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+
+
+namespace Fogg {
+
+
+
+
+// environment variable to restrict kernels to the given instruction set: scalar, sse2 or avx2
+static const char kInstructionSetKey[] = "FOGG_INSTRUCTION_SET";
+
+
+
+
+// Reference implementation, all vectorized kernels must produce bit-exact the same output.
+template<int bytesPerSample>
+static void _processSamples( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	// Vorbis sample is a float value in range [-0.5 .. +0.5].
+	// This multiplier is for the 32 bit per sample source.
+	static const float kBppMultiplier = 2147483648.f;
+
+	const int channelSampleSize = channelCount * bytesPerSample;
+	for ( int sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex )
+	{
+		for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+		{
+			const int sampleOffset = sampleIndex*channelSampleSize + channelIndex*bytesPerSample;
+
+			int value;
+
+			switch ( bytesPerSample )
+			{
+			case 1:
+				value = *reinterpret_cast<const qint8*>( rawData + sampleOffset );
+				break;
+			case 2:
+				value = *reinterpret_cast<const qint16*>( rawData + sampleOffset );
+				break;
+			case 3:
+				value = 0;
+				for ( int i = 0; i < 3; ++i )
+					reinterpret_cast<char*>( &value )[ i ] = rawData[ sampleOffset + i ];
+				if ( value & (1 << 23) )
+					value |= 0xff000000;
+				break;
+			case 4:
+				value = *reinterpret_cast<const qint32*>( rawData + sampleOffset );
+				break;
+			default:
+				Q_ASSERT( false );
+			}
+
+			const float multiplier = kBppMultiplier / (1 << (4 - bytesPerSample)*8);
+			vorbisData[ channelIndex ][ sampleIndex ] = float(value) / multiplier;
+		}
+	}
+}
+
+
+// Converts samples in range [fromSample, sampleCount) with the reference kernel.
+template<int bytesPerSample>
+static inline void _processTailSamples( const char * const rawData, float * const * const vorbisData,
+		const qint64 fromSample, const qint64 sampleCount, const int channelCount )
+{
+	if ( fromSample == sampleCount )
+		return;
+
+	float * shiftedVorbisData[ Deinterleaver::kMaxChannelCount ];
+	for ( int i = 0; i < channelCount; ++i )
+		shiftedVorbisData[ i ] = vorbisData[ i ] + fromSample;
+
+	_processSamples<bytesPerSample>( rawData + fromSample*channelCount*bytesPerSample,
+			shiftedVorbisData, sampleCount - fromSample, channelCount );
+}
+
+
+// Multiplying by the power of two reciprocal is exact, so this matches division in _processSamples().
+template<int bytesPerSample>
+static inline float _sampleScale()
+{
+	return 1.0f / float(1u << (bytesPerSample*8 - 1));
+}
+
+
+static inline qint32 _readInt24( const char * const data )
+{
+	const uchar * const bytes = reinterpret_cast<const uchar*>( data );
+	const quint32 value = quint32(bytes[ 0 ]) | (quint32(bytes[ 1 ]) << 8) | (quint32(bytes[ 2 ]) << 16);
+	return qint32( value << 8 ) >> 8;
+}
+
+
+
+
+#ifdef FOGG_DEINTERLEAVER_X86
+
+// a = L0 R0 L1 R1, b = L2 R2 L3 R3
+FOGG_TARGET_SSE2
+static inline void _sse2StoreStereo( const __m128 a, const __m128 b, float * const left, float * const right )
+{
+	_mm_storeu_ps( left,  _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+	_mm_storeu_ps( right, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+}
+
+
+FOGG_TARGET_SSE2
+static inline __m128 _sse2Int16LowToFloat( const __m128i values, const __m128 scale )
+{
+	return _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( values, values ), 16 ) ), scale );
+}
+
+
+FOGG_TARGET_SSE2
+static inline __m128 _sse2Int16HighToFloat( const __m128i values, const __m128 scale )
+{
+	return _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( values, values ), 16 ) ), scale );
+}
+
+
+// converts 16 signed bytes into 4 float vectors
+FOGG_TARGET_SSE2
+static inline void _sse2Int8ToFloat( const char * const data, const __m128 scale, __m128 * const out )
+{
+	const __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) );
+	const __m128i low = _mm_srai_epi16( _mm_unpacklo_epi8( bytes, bytes ), 8 );
+	const __m128i high = _mm_srai_epi16( _mm_unpackhi_epi8( bytes, bytes ), 8 );
+	out[ 0 ] = _sse2Int16LowToFloat( low, scale );
+	out[ 1 ] = _sse2Int16HighToFloat( low, scale );
+	out[ 2 ] = _sse2Int16LowToFloat( high, scale );
+	out[ 3 ] = _sse2Int16HighToFloat( high, scale );
+}
+
+
+FOGG_TARGET_SSE2
+static void _sse2Mono8( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m128 scale = _mm_set1_ps( _sampleScale<1>() );
+	float * const out = vorbisData[ 0 ];
+
+	qint64 i = 0;
+	for ( ; i + 16 <= sampleCount; i += 16 )
+	{
+		__m128 values[ 4 ];
+		_sse2Int8ToFloat( rawData + i, scale, values );
+		_mm_storeu_ps( out + i,      values[ 0 ] );
+		_mm_storeu_ps( out + i + 4,  values[ 1 ] );
+		_mm_storeu_ps( out + i + 8,  values[ 2 ] );
+		_mm_storeu_ps( out + i + 12, values[ 3 ] );
+	}
+
+	_processTailSamples<1>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_SSE2
+static void _sse2Stereo8( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m128 scale = _mm_set1_ps( _sampleScale<1>() );
+	float * const left = vorbisData[ 0 ];
+	float * const right = vorbisData[ 1 ];
+
+	qint64 i = 0;
+	for ( ; i + 8 <= sampleCount; i += 8 )
+	{
+		__m128 values[ 4 ];
+		_sse2Int8ToFloat( rawData + i*2, scale, values );
+		_sse2StoreStereo( values[ 0 ], values[ 1 ], left + i, right + i );
+		_sse2StoreStereo( values[ 2 ], values[ 3 ], left + i + 4, right + i + 4 );
+	}
+
+	_processTailSamples<1>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_SSE2
+static void _sse2Mono16( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m128 scale = _mm_set1_ps( _sampleScale<2>() );
+	float * const out = vorbisData[ 0 ];
+
+	qint64 i = 0;
+	for ( ; i + 8 <= sampleCount; i += 8 )
+	{
+		const __m128i values = _mm_loadu_si128( reinterpret_cast<const __m128i*>( rawData + i*2 ) );
+		_mm_storeu_ps( out + i,     _sse2Int16LowToFloat( values, scale ) );
+		_mm_storeu_ps( out + i + 4, _sse2Int16HighToFloat( values, scale ) );
+	}
+
+	_processTailSamples<2>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_SSE2
+static void _sse2Stereo16( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m128 scale = _mm_set1_ps( _sampleScale<2>() );
+	float * const left = vorbisData[ 0 ];
+	float * const right = vorbisData[ 1 ];
+
+	qint64 i = 0;
+	for ( ; i + 4 <= sampleCount; i += 4 )
+	{
+		const __m128i values = _mm_loadu_si128( reinterpret_cast<const __m128i*>( rawData + i*4 ) );
+		_sse2StoreStereo( _sse2Int16LowToFloat( values, scale ), _sse2Int16HighToFloat( values, scale ),
+				left + i, right + i );
+	}
+
+	_processTailSamples<2>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+// SSE2 has no byte shuffle, so 24-bit samples are assembled with plain integer arithmetic
+FOGG_TARGET_SSE2
+static void _sse2Int24( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const float scale = _sampleScale<3>();
+
+	const char * data = rawData;
+	for ( qint64 i = 0; i < sampleCount; ++i )
+	{
+		for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+		{
+			vorbisData[ channelIndex ][ i ] = float(_readInt24( data )) * scale;
+			data += 3;
+		}
+	}
+}
+
+
+FOGG_TARGET_SSE2
+static void _sse2Mono32( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m128 scale = _mm_set1_ps( _sampleScale<4>() );
+	float * const out = vorbisData[ 0 ];
+
+	qint64 i = 0;
+	for ( ; i + 4 <= sampleCount; i += 4 )
+	{
+		const __m128i values = _mm_loadu_si128( reinterpret_cast<const __m128i*>( rawData + i*4 ) );
+		_mm_storeu_ps( out + i, _mm_mul_ps( _mm_cvtepi32_ps( values ), scale ) );
+	}
+
+	_processTailSamples<4>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_SSE2
+static void _sse2Stereo32( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m128 scale = _mm_set1_ps( _sampleScale<4>() );
+	float * const left = vorbisData[ 0 ];
+	float * const right = vorbisData[ 1 ];
+
+	qint64 i = 0;
+	for ( ; i + 4 <= sampleCount; i += 4 )
+	{
+		const __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( rawData + i*8 ) );
+		const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( rawData + i*8 + 16 ) );
+		_sse2StoreStereo( _mm_mul_ps( _mm_cvtepi32_ps( a ), scale ), _mm_mul_ps( _mm_cvtepi32_ps( b ), scale ),
+				left + i, right + i );
+	}
+
+	_processTailSamples<4>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+
+
+// a = L0 R0 L1 R1 | L2 R2 L3 R3, b = L4 R4 L5 R5 | L6 R6 L7 R7
+FOGG_TARGET_AVX2
+static inline void _avx2StoreStereo( const __m256 a, const __m256 b, float * const left, float * const right )
+{
+	// per lane shuffle gives L0 L1 L4 L5 | L2 L3 L6 L7, then 64-bit permute restores order
+	const __m256 l = _mm256_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+	const __m256 r = _mm256_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+	_mm256_storeu_ps( left,  _mm256_castpd_ps( _mm256_permute4x64_pd( _mm256_castps_pd( l ), _MM_SHUFFLE( 3, 1, 2, 0 ) ) ) );
+	_mm256_storeu_ps( right, _mm256_castpd_ps( _mm256_permute4x64_pd( _mm256_castps_pd( r ), _MM_SHUFFLE( 3, 1, 2, 0 ) ) ) );
+}
+
+
+FOGG_TARGET_AVX2
+static inline __m256 _avx2Int8ToFloat( const char * const data, const __m256 scale )
+{
+	const __m128i bytes = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( data ) );
+	return _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvtepi8_epi32( bytes ) ), scale );
+}
+
+
+FOGG_TARGET_AVX2
+static inline __m256 _avx2Int16ToFloat( const char * const data, const __m256 scale )
+{
+	const __m128i values = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) );
+	return _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( values ) ), scale );
+}
+
+
+// Converts 8 packed 24-bit samples. Reads 28 bytes, i.e. 4 bytes past the last sample.
+FOGG_TARGET_AVX2
+static inline __m256 _avx2Int24ToFloat( const char * const data, const __m256 scale )
+{
+	// place 3 sample bytes into the upper bytes of each 32-bit value, lowest byte is zeroed
+	const __m256i shuffleMask = _mm256_setr_epi8(
+			-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+			-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11 );
+
+	const __m256i bytes = _mm256_inserti128_si256( _mm256_castsi128_si256(
+			_mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) ) ),
+			_mm_loadu_si128( reinterpret_cast<const __m128i*>( data + 12 ) ), 1 );
+
+	// arithmetic shift restores the sign
+	const __m256i values = _mm256_srai_epi32( _mm256_shuffle_epi8( bytes, shuffleMask ), 8 );
+	return _mm256_mul_ps( _mm256_cvtepi32_ps( values ), scale );
+}
+
+
+FOGG_TARGET_AVX2
+static inline __m256 _avx2Int32ToFloat( const char * const data, const __m256 scale )
+{
+	const __m256i values = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+	return _mm256_mul_ps( _mm256_cvtepi32_ps( values ), scale );
+}
+
+
+FOGG_TARGET_AVX2
+static void _avx2Mono8( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m256 scale = _mm256_set1_ps( _sampleScale<1>() );
+	float * const out = vorbisData[ 0 ];
+
+	qint64 i = 0;
+	for ( ; i + 16 <= sampleCount; i += 16 )
+	{
+		_mm256_storeu_ps( out + i,     _avx2Int8ToFloat( rawData + i, scale ) );
+		_mm256_storeu_ps( out + i + 8, _avx2Int8ToFloat( rawData + i + 8, scale ) );
+	}
+
+	_processTailSamples<1>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_AVX2
+static void _avx2Stereo8( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m256 scale = _mm256_set1_ps( _sampleScale<1>() );
+
+	qint64 i = 0;
+	for ( ; i + 8 <= sampleCount; i += 8 )
+	{
+		_avx2StoreStereo( _avx2Int8ToFloat( rawData + i*2, scale ), _avx2Int8ToFloat( rawData + i*2 + 8, scale ),
+				vorbisData[ 0 ] + i, vorbisData[ 1 ] + i );
+	}
+
+	_processTailSamples<1>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_AVX2
+static void _avx2Mono16( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m256 scale = _mm256_set1_ps( _sampleScale<2>() );
+	float * const out = vorbisData[ 0 ];
+
+	qint64 i = 0;
+	for ( ; i + 8 <= sampleCount; i += 8 )
+		_mm256_storeu_ps( out + i, _avx2Int16ToFloat( rawData + i*2, scale ) );
+
+	_processTailSamples<2>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_AVX2
+static void _avx2Stereo16( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m256 scale = _mm256_set1_ps( _sampleScale<2>() );
+
+	qint64 i = 0;
+	for ( ; i + 8 <= sampleCount; i += 8 )
+	{
+		_avx2StoreStereo( _avx2Int16ToFloat( rawData + i*4, scale ), _avx2Int16ToFloat( rawData + i*4 + 16, scale ),
+				vorbisData[ 0 ] + i, vorbisData[ 1 ] + i );
+	}
+
+	_processTailSamples<2>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_AVX2
+static void _avx2Mono24( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m256 scale = _mm256_set1_ps( _sampleScale<3>() );
+	float * const out = vorbisData[ 0 ];
+
+	// keep 2 samples after each block, so 4 bytes overread stays inside the buffer
+	qint64 i = 0;
+	for ( ; i + 8 + 2 <= sampleCount; i += 8 )
+		_mm256_storeu_ps( out + i, _avx2Int24ToFloat( rawData + i*3, scale ) );
+
+	_processTailSamples<3>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_AVX2
+static void _avx2Stereo24( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m256 scale = _mm256_set1_ps( _sampleScale<3>() );
+
+	// keep 1 sample after each block, so 4 bytes overread stays inside the buffer
+	qint64 i = 0;
+	for ( ; i + 8 + 1 <= sampleCount; i += 8 )
+	{
+		_avx2StoreStereo( _avx2Int24ToFloat( rawData + i*6, scale ), _avx2Int24ToFloat( rawData + i*6 + 24, scale ),
+				vorbisData[ 0 ] + i, vorbisData[ 1 ] + i );
+	}
+
+	_processTailSamples<3>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_AVX2
+static void _avx2Mono32( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m256 scale = _mm256_set1_ps( _sampleScale<4>() );
+	float * const out = vorbisData[ 0 ];
+
+	qint64 i = 0;
+	for ( ; i + 8 <= sampleCount; i += 8 )
+		_mm256_storeu_ps( out + i, _avx2Int32ToFloat( rawData + i*4, scale ) );
+
+	_processTailSamples<4>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+FOGG_TARGET_AVX2
+static void _avx2Stereo32( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m256 scale = _mm256_set1_ps( _sampleScale<4>() );
+
+	qint64 i = 0;
+	for ( ; i + 8 <= sampleCount; i += 8 )
+	{
+		_avx2StoreStereo( _avx2Int32ToFloat( rawData + i*8, scale ), _avx2Int32ToFloat( rawData + i*8 + 32, scale ),
+				vorbisData[ 0 ] + i, vorbisData[ 1 ] + i );
+	}
+
+	_processTailSamples<4>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+
+
+// Surround kernel for any channel count, each channel is gathered with the stride of the whole sample.
+// Every gather reads 4 bytes, that is up to 3 bytes past the last channel sample.
+template<int bytesPerSample>
+FOGG_TARGET_AVX2
+static void _avx2Gather( const char * const rawData, float * const * const vorbisData, const qint64 sampleCount,
+		const int channelCount )
+{
+	const __m256 scale = _mm256_set1_ps( _sampleScale<bytesPerSample>() );
+	const int channelSampleSize = channelCount * bytesPerSample;
+	const __m256i offsets = _mm256_mullo_epi32( _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ),
+			_mm256_set1_epi32( channelSampleSize ) );
+
+	// gathered value holds sample in the low bytes, shifting back and forth restores the sign
+	const int shift = 32 - bytesPerSample*8;
+
+	// keep 1 sample after each block, so overread stays inside the buffer
+	qint64 i = 0;
+	for ( ; i + 8 + 1 <= sampleCount; i += 8 )
+	{
+		const char * const data = rawData + i*channelSampleSize;
+		for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+		{
+			__m256i values = _mm256_i32gather_epi32( reinterpret_cast<const int*>( data + channelIndex*bytesPerSample ),
+					offsets, 1 );
+			if ( shift != 0 )
+				values = _mm256_srai_epi32( _mm256_slli_epi32( values, shift ), shift );
+			_mm256_storeu_ps( vorbisData[ channelIndex ] + i, _mm256_mul_ps( _mm256_cvtepi32_ps( values ), scale ) );
+		}
+	}
+
+	_processTailSamples<bytesPerSample>( rawData, vorbisData, i, sampleCount, channelCount );
+}
+
+#endif // FOGG_DEINTERLEAVER_X86
+
+
+
+
+static Deinterleaver::InstructionSet _detectInstructionSet()
+{
+#ifdef FOGG_DEINTERLEAVER_X86
+	__builtin_cpu_init();
+
+	if ( __builtin_cpu_supports( "avx2" ) )
+		return Deinterleaver::InstructionSet_Avx2;
+
+	if ( __builtin_cpu_supports( "sse2" ) )
+		return Deinterleaver::InstructionSet_Sse2;
+#endif
+
+	return Deinterleaver::InstructionSet_Scalar;
+}
+
+
+static Deinterleaver::InstructionSet _restrictedInstructionSet( const Deinterleaver::InstructionSet instructionSet )
+{
+	const QByteArray restriction = qgetenv( kInstructionSetKey ).toLower();
+
+	if ( restriction == "scalar" )
+		return Deinterleaver::InstructionSet_Scalar;
+
+	if ( restriction == "sse2" )
+		return qMin( instructionSet, Deinterleaver::InstructionSet_Sse2 );
+
+	return instructionSet;
+}
+
+
+Deinterleaver::InstructionSet Deinterleaver::bestInstructionSet()
+{
+	static const InstructionSet kInstructionSet = _restrictedInstructionSet( _detectInstructionSet() );
+	return kInstructionSet;
+}
+
+
+Deinterleaver::Kernel Deinterleaver::kernel( const int channelCount, const int bitsPerSample )
+{
+	return kernel( channelCount, bitsPerSample, bestInstructionSet() );
+}
+
+
+Deinterleaver::Kernel Deinterleaver::kernel( const int channelCount, const int bitsPerSample,
+		const InstructionSet instructionSet )
+{
+	Q_ASSERT( channelCount >= 1 && channelCount <= kMaxChannelCount );
+
+#ifdef FOGG_DEINTERLEAVER_X86
+	switch ( instructionSet )
+	{
+	case InstructionSet_Avx2:
+		if ( channelCount > 2 )
+		{
+			switch ( bitsPerSample )
+			{
+			case  8: return _avx2Gather<1>;
+			case 16: return _avx2Gather<2>;
+			case 24: return _avx2Gather<3>;
+			case 32: return _avx2Gather<4>;
+			}
+			break;
+		}
+
+		switch ( bitsPerSample )
+		{
+		case  8: return channelCount == 1 ? _avx2Mono8  : _avx2Stereo8;
+		case 16: return channelCount == 1 ? _avx2Mono16 : _avx2Stereo16;
+		case 24: return channelCount == 1 ? _avx2Mono24 : _avx2Stereo24;
+		case 32: return channelCount == 1 ? _avx2Mono32 : _avx2Stereo32;
+		}
+		break;
+
+	case InstructionSet_Sse2:
+		// SSE2 has no gather, surround goes to the reference kernel
+		if ( channelCount > 2 )
+			break;
+
+		switch ( bitsPerSample )
+		{
+		case  8: return channelCount == 1 ? _sse2Mono8  : _sse2Stereo8;
+		case 16: return channelCount == 1 ? _sse2Mono16 : _sse2Stereo16;
+		case 24: return _sse2Int24;
+		case 32: return channelCount == 1 ? _sse2Mono32 : _sse2Stereo32;
+		}
+		break;
+
+	case InstructionSet_Scalar:
+		break;
+	}
+#else
+	Q_UNUSED( instructionSet );
+#endif
+
+	switch ( bitsPerSample )
+	{
+	case  8: return _processSamples<1>;
+	case 16: return _processSamples<2>;
+	case 24: return _processSamples<3>;
+	case 32: return _processSamples<4>;
+	}
+
+	Q_ASSERT( false );
+	return 0;
+}
+
+
+void Deinterleaver::mapChannels( float * const * const vorbisData, const int channelCount, float ** const channels )
+{
+	Q_ASSERT( channelCount >= 1 && channelCount <= kMaxChannelCount );
+
+	// Vorbis channel for each WAVE channel, see Vorbis I specification, section 4.3.9
+	static const int kVorbisChannels[ kMaxChannelCount ][ kMaxChannelCount ] =
+	{
+		{ 0 },
+		{ 0, 1 },
+		{ 0, 2, 1 },
+		{ 0, 1, 2, 3 },
+		{ 0, 2, 1, 3, 4 },
+		{ 0, 2, 1, 5, 3, 4 },
+		{ 0, 2, 1, 6, 5, 3, 4 },
+		{ 0, 2, 1, 7, 5, 6, 3, 4 }
+	};
+
+	for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+		channels[ channelIndex ] = vorbisData[ kVorbisChannels[ channelCount - 1 ][ channelIndex ] ];
+}
+
+
+
+
+} // namespace Fogg
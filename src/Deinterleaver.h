@@ -0,0 +1,45 @@
+
+#pragma once
+
+#include <QtGlobal>
+
+
+
+
+namespace Fogg {
+
+
+
+
+class Deinterleaver
+{
+public:
+	enum InstructionSet
+	{
+		InstructionSet_Scalar = 0,
+		InstructionSet_Sse2   = 1,
+		InstructionSet_Avx2   = 2
+	};
+
+	static const int kMaxChannelCount = 8;
+
+	// Converts sampleCount interleaved integer PCM samples from rawData into
+	// Vorbis float channel arrays, as returned by vorbis_analysis_buffer().
+	// channelCount must be the one the kernel was requested for.
+	typedef void (*Kernel)( const char * rawData, float * const * vorbisData, qint64 sampleCount, int channelCount );
+
+	static InstructionSet bestInstructionSet();
+
+	// WAVE and FLAC order surround channels as FL FR C LFE ..., Vorbis as FL C FR ... LFE.
+	// Fills channels with vorbisData pointers permuted into WAVE channel order,
+	// so decoded samples can be written through them without reordering.
+	static void mapChannels( float * const * vorbisData, int channelCount, float ** channels );
+
+	static Kernel kernel( int channelCount, int bitsPerSample );
+	static Kernel kernel( int channelCount, int bitsPerSample, InstructionSet instructionSet );
+};
+
+
+
+
+} // namespace Fogg
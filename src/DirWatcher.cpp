@@ -0,0 +1,447 @@
+
+#include "DirWatcher.h"
+
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDirIterator>
+#include <QDateTime>
+#include <QPair>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#endif
+
+#include "Global.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+// file is reported once it was not written for this long, copying over network may stall for a while
+static const int kSettleInterval = 2*1000;
+static const int kSettleCheckInterval = 500;
+
+// rescan after overflow waits for the burst of changes to calm down a bit,
+// file times are compared with a margin for file systems with coarse timestamps
+static const int kRescanDelay = 1000;
+static const qint64 kRescanTimeMargin = 2*1000;
+
+#ifdef Q_OS_LINUX
+static const quint32 kWatchMask = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM |
+		IN_DELETE | IN_ONLYDIR;
+
+static const int kEventBufferSize = 64*(sizeof(struct inotify_event) + NAME_MAX + 1);
+#endif
+
+
+
+
+#ifdef Q_OS_LINUX
+// Later of modification and status change times, the latter catches files moved in with their old mtime.
+static qint64 _changeTimeForFile( const QString & filePath )
+{
+	struct stat st;
+	if ( ::stat( QFile::encodeName( filePath ).constData(), &st ) != 0 )
+		return 0;
+
+	const qint64 modified = qint64(st.st_mtim.tv_sec)*1000 + st.st_mtim.tv_nsec/1000000;
+	const qint64 changed = qint64(st.st_ctim.tv_sec)*1000 + st.st_ctim.tv_nsec/1000000;
+	return qMax( modified, changed );
+}
+#endif
+
+
+
+
+bool DirWatcher::isSupported()
+{
+#ifdef Q_OS_LINUX
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+DirWatcher::DirWatcher( QObject * const parent ) :
+	QObject( parent )
+{
+	fd_ = -1;
+	notifier_ = 0;
+
+	settleTimer_ = new QTimer( this );
+	settleTimer_->setInterval( kSettleCheckInterval );
+	connect( settleTimer_, SIGNAL(timeout()), SLOT(_reportSettledFiles()) );
+
+	drainedTime_ = 0;
+	rescanChangedSince_ = 0;
+
+	rescanTimer_ = new QTimer( this );
+	rescanTimer_->setSingleShot( true );
+	rescanTimer_->setInterval( kRescanDelay );
+	connect( rescanTimer_, SIGNAL(timeout()), SLOT(_rescan()) );
+}
+
+
+DirWatcher::~DirWatcher()
+{
+	_stop();
+}
+
+
+void DirWatcher::setFilters( const QStringList & filters )
+{
+	filters_ = filters;
+
+	filterRegExps_.clear();
+	foreach ( const QString & filter, filters_ )
+		filterRegExps_ << QRegExp( filter, Qt::CaseInsensitive, QRegExp::Wildcard );
+}
+
+
+void DirWatcher::setPaths( const QStringList & paths )
+{
+	if ( paths == paths_ )
+		return;
+
+	_stop();
+	paths_ = paths;
+	_start();
+}
+
+
+void DirWatcher::_start()
+{
+#ifdef Q_OS_LINUX
+	Q_ASSERT( fd_ == -1 );
+
+	if ( paths_.isEmpty() )
+		return;
+
+	fd_ = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if ( fd_ == -1 )
+	{
+		foggWarning() << "Error initializing inotify, errno:" << errno;
+		return;
+	}
+
+	notifier_ = new QSocketNotifier( fd_, QSocketNotifier::Read, this );
+	connect( notifier_, SIGNAL(activated(int)), SLOT(_readEvents()) );
+
+	// files existing before watching has started are not reported
+	drainedTime_ = QDateTime::currentMSecsSinceEpoch();
+
+	foreach ( const QString & path, paths_ )
+	{
+		const QFileInfo pathInfo = QFileInfo( path );
+		if ( !pathInfo.isDir() )
+			continue;
+
+		// same base path as when the directory is added by hand
+		_addWatchRecursively( pathInfo.absoluteFilePath(), pathInfo.path(), false );
+	}
+#endif
+}
+
+
+void DirWatcher::_stop()
+{
+#ifdef Q_OS_LINUX
+	if ( fd_ == -1 )
+		return;
+
+	delete notifier_;
+	notifier_ = 0;
+
+	// closing descriptor removes all the watches
+	::close( fd_ );
+	fd_ = -1;
+
+	watchedDirForDescriptor_.clear();
+	descriptorForDirPath_.clear();
+
+	pendingFileForPath_.clear();
+	settleTimer_->stop();
+	rescanTimer_->stop();
+#endif
+}
+
+
+bool DirWatcher::_matchesFilters( const QString & fileName ) const
+{
+	foreach ( const QRegExp & filter, filterRegExps_ )
+		if ( filter.exactMatch( fileName ) )
+			return true;
+	return false;
+}
+
+
+// Files are queued only if they have changed since queueChangedSince, zero queues all of them.
+void DirWatcher::_addWatchRecursively( const QString & dirPath, const QString & basePath, const bool queueFiles,
+		const qint64 queueChangedSince )
+{
+	if ( !_addWatch( dirPath, basePath ) )
+		return;
+
+	// parent is watched already, entries created meanwhile are reported by events
+	const QDir::Filters entryFilters = queueFiles ?
+			QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot :
+			QDir::Dirs | QDir::NoDotAndDotDot;
+
+	for ( QDirIterator it( dirPath, entryFilters, QDirIterator::Subdirectories ); it.hasNext(); )
+	{
+		it.next();
+
+		const QFileInfo entryInfo = it.fileInfo();
+		if ( entryInfo.isDir() )
+			_addWatch( entryInfo.absoluteFilePath(), basePath );
+		else if ( _matchesFilters( entryInfo.fileName() ) )
+		{
+#ifdef Q_OS_LINUX
+			if ( queueChangedSince != 0 && _changeTimeForFile( entryInfo.absoluteFilePath() ) < queueChangedSince )
+				continue;
+#endif
+			_queueFile( entryInfo.absoluteFilePath(), basePath );
+		}
+	}
+}
+
+
+bool DirWatcher::_addWatch( const QString & dirPath, const QString & basePath )
+{
+#ifdef Q_OS_LINUX
+	const int wd = inotify_add_watch( fd_, QFile::encodeName( dirPath ).constData(), kWatchMask );
+	if ( wd == -1 )
+	{
+		if ( errno == ENOSPC )
+			foggWarning() << "Out of inotify watches, consider raising fs.inotify.max_user_watches:" << dirPath;
+		else
+			foggWarning() << "Error watching directory:" << dirPath << "errno:" << errno;
+		return false;
+	}
+
+	// same directory may be reached by another path
+	const QHash<int,WatchedDir>::const_iterator it = watchedDirForDescriptor_.constFind( wd );
+	if ( it != watchedDirForDescriptor_.constEnd() )
+		descriptorForDirPath_.remove( it.value().path );
+
+	WatchedDir & watchedDir = watchedDirForDescriptor_[ wd ];
+	watchedDir.path = dirPath;
+	watchedDir.basePath = basePath;
+	descriptorForDirPath_[ dirPath ] = wd;
+
+	return true;
+#else
+	Q_UNUSED( dirPath );
+	Q_UNUSED( basePath );
+	return false;
+#endif
+}
+
+
+void DirWatcher::_removeWatchRecursively( const QString & dirPath )
+{
+#ifdef Q_OS_LINUX
+	const QString pathPrefix = dirPath + QLatin1Char( '/' );
+
+	for ( QHash<QString,int>::iterator it = descriptorForDirPath_.begin(); it != descriptorForDirPath_.end(); )
+	{
+		if ( it.key() != dirPath && !it.key().startsWith( pathPrefix ) )
+		{
+			++it;
+			continue;
+		}
+
+		// directory moved away is still watched under the new name, forget it explicitly
+		inotify_rm_watch( fd_, it.value() );
+		watchedDirForDescriptor_.remove( it.value() );
+		it = descriptorForDirPath_.erase( it );
+	}
+
+	for ( QHash<QString,PendingFile>::iterator it = pendingFileForPath_.begin(); it != pendingFileForPath_.end(); )
+	{
+		if ( it.key().startsWith( pathPrefix ) )
+			it = pendingFileForPath_.erase( it );
+		else
+			++it;
+	}
+#else
+	Q_UNUSED( dirPath );
+#endif
+}
+
+
+void DirWatcher::_queueFile( const QString & filePath, const QString & basePath )
+{
+	PendingFile & pendingFile = pendingFileForPath_[ filePath ];
+	pendingFile.basePath = basePath;
+	pendingFile.lastChanged = QDateTime::currentMSecsSinceEpoch();
+
+	if ( !settleTimer_->isActive() )
+		settleTimer_->start();
+}
+
+
+void DirWatcher::_readEvents()
+{
+#ifdef Q_OS_LINUX
+	union
+	{
+		struct inotify_event event;
+		char bytes[ kEventBufferSize ];
+	} buffer;
+
+	// events happening since now stay in queue until the next read
+	const qint64 readTime = QDateTime::currentMSecsSinceEpoch();
+
+	while ( true )
+	{
+		const ssize_t size = ::read( fd_, buffer.bytes, kEventBufferSize );
+		if ( size <= 0 )
+			break;
+
+		for ( ssize_t offset = 0; offset < size; )
+		{
+			const struct inotify_event * const event = reinterpret_cast<const struct inotify_event*>( buffer.bytes + offset );
+			offset += sizeof(struct inotify_event) + event->len;
+
+			if ( event->mask & IN_Q_OVERFLOW )
+			{
+				// lost events happened after the queue was read empty last time
+				foggWarning() << "inotify queue overflow, rescanning watched directories";
+				rescanChangedSince_ = rescanTimer_->isActive() ? qMin( rescanChangedSince_, drainedTime_ ) : drainedTime_;
+				rescanTimer_->start();
+				continue;
+			}
+
+			if ( event->mask & IN_IGNORED )
+			{
+				// directory was removed or unmounted
+				const QHash<int,WatchedDir>::iterator it = watchedDirForDescriptor_.find( event->wd );
+				if ( it != watchedDirForDescriptor_.end() )
+				{
+					descriptorForDirPath_.remove( it.value().path );
+					watchedDirForDescriptor_.erase( it );
+				}
+				continue;
+			}
+
+			if ( event->len == 0 )
+				continue;
+
+			const QHash<int,WatchedDir>::const_iterator it = watchedDirForDescriptor_.constFind( event->wd );
+			if ( it == watchedDirForDescriptor_.constEnd() )
+				continue;
+
+			const QString name = QFile::decodeName( event->name );
+			if ( name.startsWith( QLatin1Char( '.' ) ) )
+				continue;
+
+			const WatchedDir watchedDir = it.value();
+			const QString path = watchedDir.path + QLatin1Char( '/' ) + name;
+
+			if ( event->mask & IN_ISDIR )
+			{
+				if ( event->mask & (IN_CREATE | IN_MOVED_TO) )
+				{
+					// whole tree could be moved in, its files are new as well
+					_addWatchRecursively( path, watchedDir.basePath, true );
+				}
+				else if ( event->mask & (IN_DELETE | IN_MOVED_FROM) )
+				{
+					_removeWatchRecursively( path );
+				}
+				continue;
+			}
+
+			if ( event->mask & (IN_DELETE | IN_MOVED_FROM) )
+			{
+				pendingFileForPath_.remove( path );
+				continue;
+			}
+
+			if ( _matchesFilters( name ) )
+				_queueFile( path, watchedDir.basePath );
+		}
+	}
+
+	drainedTime_ = readTime;
+#endif
+}
+
+
+// Syncs watches with directory trees and queues files changed while events were lost.
+// False positives are harmless, up to date files are skipped by conversion manifest.
+void DirWatcher::_rescan()
+{
+#ifdef Q_OS_LINUX
+	if ( fd_ == -1 )
+		return;
+
+	// directories removed meanwhile, IN_IGNORED for them might be lost too
+	QStringList removedDirPaths;
+	for ( QHash<QString,int>::const_iterator it = descriptorForDirPath_.constBegin(); it != descriptorForDirPath_.constEnd(); ++it )
+		if ( !QFileInfo( it.key() ).isDir() )
+			removedDirPaths << it.key();
+
+	foreach ( const QString & dirPath, removedDirPaths )
+		_removeWatchRecursively( dirPath );
+
+	// watches are added for new directories, existing ones keep their descriptors
+	const qint64 changedSince = qMax<qint64>( 1, rescanChangedSince_ - kRescanTimeMargin );
+	foreach ( const QString & path, paths_ )
+	{
+		const QFileInfo pathInfo = QFileInfo( path );
+		if ( !pathInfo.isDir() )
+			continue;
+
+		_addWatchRecursively( pathInfo.absoluteFilePath(), pathInfo.path(), true, changedSince );
+	}
+#endif
+}
+
+
+void DirWatcher::_reportSettledFiles()
+{
+	const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+	QList<QPair<QString,QString> > settledFiles;
+	for ( QHash<QString,PendingFile>::iterator it = pendingFileForPath_.begin(); it != pendingFileForPath_.end(); )
+	{
+		if ( now - it.value().lastChanged < kSettleInterval )
+		{
+			++it;
+			continue;
+		}
+
+		settledFiles << qMakePair( it.key(), it.value().basePath );
+		it = pendingFileForPath_.erase( it );
+	}
+
+	if ( pendingFileForPath_.isEmpty() )
+		settleTimer_->stop();
+
+	for ( int i = 0; i < settledFiles.count(); ++i )
+	{
+		const QString & filePath = settledFiles.at( i ).first;
+		if ( !QFileInfo( filePath ).isFile() )
+			continue;
+
+		emit fileSettled( filePath, settledFiles.at( i ).second );
+	}
+}
+
+
+
+
+} // namespace Fogg
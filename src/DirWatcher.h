@@ -0,0 +1,114 @@
+
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QHash>
+#include <QRegExp>
+
+
+
+
+class QSocketNotifier;
+class QTimer;
+
+
+
+
+namespace Fogg {
+
+
+
+
+// Watches directory trees for new or modified files matching filters.
+// Watches are added and removed incrementally as subdirectories appear and disappear,
+// tree is rescanned only when inotify queue overflows and events are lost.
+// File is reported once no writes happened to it for a while.
+// Implemented with inotify, on other platforms watcher does nothing.
+class DirWatcher : public QObject
+{
+	Q_OBJECT
+
+public:
+	static bool isSupported();
+
+	DirWatcher( QObject * parent = 0 );
+	~DirWatcher();
+
+	QStringList filters() const;
+	void setFilters( const QStringList & filters );
+
+	// empty list stops watching
+	QStringList paths() const;
+	void setPaths( const QStringList & paths );
+
+signals:
+	void fileSettled( const QString & filePath, const QString & basePath );
+
+private:
+	class WatchedDir
+	{
+	public:
+		QString path;
+		QString basePath;
+	};
+
+	class PendingFile
+	{
+	public:
+		PendingFile() :
+			lastChanged( 0 )
+		{}
+
+		QString basePath;
+		qint64 lastChanged;
+	};
+
+	void _start();
+	void _stop();
+
+	bool _matchesFilters( const QString & fileName ) const;
+	void _addWatchRecursively( const QString & dirPath, const QString & basePath, bool queueFiles,
+			qint64 queueChangedSince = 0 );
+	bool _addWatch( const QString & dirPath, const QString & basePath );
+	void _removeWatchRecursively( const QString & dirPath );
+	void _queueFile( const QString & filePath, const QString & basePath );
+
+private slots:
+	void _readEvents();
+	void _reportSettledFiles();
+	void _rescan();
+
+private:
+	QStringList filters_;
+	QList<QRegExp> filterRegExps_;
+	QStringList paths_;
+
+	int fd_;
+	QSocketNotifier * notifier_;
+	QHash<int,WatchedDir> watchedDirForDescriptor_;
+	QHash<QString,int> descriptorForDirPath_;
+
+	QHash<QString,PendingFile> pendingFileForPath_;
+	QTimer * settleTimer_;
+
+	// events are complete up to the time queue was read empty last time,
+	// after overflow files changed since then are queued by rescan
+	qint64 drainedTime_;
+	qint64 rescanChangedSince_;
+	QTimer * rescanTimer_;
+};
+
+
+
+
+inline QStringList DirWatcher::filters() const
+{ return filters_; }
+
+inline QStringList DirWatcher::paths() const
+{ return paths_; }
+
+
+
+
+} // namespace Fogg
@@ -0,0 +1,211 @@
+#include "EncoderSettings.h"
+
+#include <QDataStream>
+
+#include <vorbis/vorbisenc.h>
+
+#include "Global.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+static const QString kModeNames[] = {
+	QLatin1String( "quality" ),
+	QLatin1String( "average" ),
+	QLatin1String( "constant" )
+};
+
+static const int kModeCount = int(sizeof(kModeNames)/sizeof(QString));
+
+// Approximate libvorbis bitrates in kbit/s for 44.1kHz stereo, quality -0.1 .. 1.0 with 0.1 step.
+static const int kNominalBitrates[] = { 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 500 };
+
+
+
+
+static bool _isBitrateInRange( const int bitrate )
+{
+	return bitrate >= kMinimumBitrateValue && bitrate <= kMaximumBitrateValue;
+}
+
+
+static long _bitsForBitrate( const int bitrate )
+{
+	return bitrate == -1 ? -1 : long(bitrate) * 1000;
+}
+
+
+
+
+EncoderSettings::EncoderSettings()
+{
+	mode = Mode_Quality;
+	quality = 0;
+	minimumBitrate = -1;
+	nominalBitrate = -1;
+	maximumBitrate = -1;
+}
+
+
+EncoderSettings EncoderSettings::fromQuality( const qreal quality )
+{
+	EncoderSettings settings;
+	settings.quality = quality;
+	return settings;
+}
+
+
+EncoderSettings EncoderSettings::fromAverageBitrate( const int nominalBitrate, const int minimumBitrate,
+		const int maximumBitrate )
+{
+	EncoderSettings settings;
+	settings.mode = Mode_Average;
+	settings.minimumBitrate = minimumBitrate;
+	settings.nominalBitrate = nominalBitrate;
+	settings.maximumBitrate = maximumBitrate;
+	return settings;
+}
+
+
+EncoderSettings EncoderSettings::fromConstantBitrate( const int bitrate )
+{
+	EncoderSettings settings;
+	settings.mode = Mode_Constant;
+	settings.minimumBitrate = bitrate;
+	settings.nominalBitrate = bitrate;
+	settings.maximumBitrate = bitrate;
+	return settings;
+}
+
+
+QString EncoderSettings::nameForMode( const Mode mode )
+{
+	Q_ASSERT( mode >= 0 && mode < kModeCount );
+	return kModeNames[ mode ];
+}
+
+
+EncoderSettings::Mode EncoderSettings::modeForName( const QString & name, bool * const isValid )
+{
+	for ( int i = 0; i < kModeCount; ++i )
+	{
+		if ( kModeNames[ i ] == name )
+		{
+			if ( isValid )
+				*isValid = true;
+			return static_cast<Mode>( i );
+		}
+	}
+
+	if ( isValid )
+		*isValid = false;
+	return Mode_Quality;
+}
+
+
+bool EncoderSettings::isValid() const
+{
+	switch ( mode )
+	{
+	case Mode_Quality:
+		return quality >= kMinimumQualityValue && quality <= kMaximumQualityValue;
+
+	case Mode_Average:
+		return _isBitrateInRange( nominalBitrate ) &&
+				(minimumBitrate == -1 || (minimumBitrate >= kMinimumBitrateValue && minimumBitrate <= nominalBitrate)) &&
+				(maximumBitrate == -1 || (maximumBitrate >= nominalBitrate && maximumBitrate <= kMaximumBitrateValue));
+
+	case Mode_Constant:
+		return _isBitrateInRange( nominalBitrate ) &&
+				minimumBitrate == nominalBitrate && maximumBitrate == nominalBitrate;
+	}
+
+	return false;
+}
+
+
+int EncoderSettings::expectedBitrate() const
+{
+	if ( isManaged() )
+		return nominalBitrate;
+
+	const int bitrateIndex = qBound( 0, qRound( quality*10 ) + 1, int(sizeof(kNominalBitrates)/sizeof(int)) - 1 );
+	return kNominalBitrates[ bitrateIndex ];
+}
+
+
+bool EncoderSettings::initVorbisInfo( vorbis_info * const vi, const int channels, const long frequency ) const
+{
+	Q_ASSERT( isValid() );
+
+	if ( !isManaged() )
+		return vorbis_encode_init_vbr( vi, channels, frequency, quality ) == 0;
+
+	if ( vorbis_encode_setup_managed( vi, channels, frequency,
+			_bitsForBitrate( maximumBitrate ), _bitsForBitrate( nominalBitrate ), _bitsForBitrate( minimumBitrate ) ) )
+		return false;
+
+	// bounds given are hard limits, bit reservoir only smooths bitrate in between,
+	// zero limit is treated by libvorbis as no limit
+	ovectl_ratemanage2_arg rateManagement;
+	if ( vorbis_encode_ctl( vi, OV_ECTL_RATEMANAGE2_GET, &rateManagement ) )
+		return false;
+
+	rateManagement.management_active = 1;
+	rateManagement.bitrate_limit_min_kbps = minimumBitrate == -1 ? 0 : minimumBitrate;
+	rateManagement.bitrate_limit_max_kbps = maximumBitrate == -1 ? 0 : maximumBitrate;
+	rateManagement.bitrate_average_kbps = nominalBitrate;
+
+	if ( vorbis_encode_ctl( vi, OV_ECTL_RATEMANAGE2_SET, &rateManagement ) )
+		return false;
+
+	return vorbis_encode_setup_init( vi ) == 0;
+}
+
+
+bool EncoderSettings::operator==( const EncoderSettings & other ) const
+{
+	if ( mode != other.mode )
+		return false;
+
+	if ( !isManaged() )
+		return quality == other.quality;
+
+	return minimumBitrate == other.minimumBitrate && nominalBitrate == other.nominalBitrate &&
+			maximumBitrate == other.maximumBitrate;
+}
+
+
+
+
+QDataStream & operator<<( QDataStream & stream, const EncoderSettings & settings )
+{
+	return stream << qint32(settings.mode) << settings.quality
+			<< qint32(settings.minimumBitrate) << qint32(settings.nominalBitrate) << qint32(settings.maximumBitrate);
+}
+
+
+QDataStream & operator>>( QDataStream & stream, EncoderSettings & settings )
+{
+	qint32 mode;
+	qint32 minimumBitrate;
+	qint32 nominalBitrate;
+	qint32 maximumBitrate;
+	stream >> mode >> settings.quality >> minimumBitrate >> nominalBitrate >> maximumBitrate;
+
+	settings.mode = static_cast<EncoderSettings::Mode>( mode );
+	settings.minimumBitrate = minimumBitrate;
+	settings.nominalBitrate = nominalBitrate;
+	settings.maximumBitrate = maximumBitrate;
+	return stream;
+}
+
+
+
+
+} // namespace Fogg
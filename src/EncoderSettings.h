@@ -0,0 +1,81 @@
+
+#pragma once
+
+#include <QString>
+
+
+
+
+class QDataStream;
+
+struct vorbis_info;
+
+
+
+
+namespace Fogg {
+
+
+
+
+// How Vorbis encoder spends bits.
+// Quality mode is plain VBR, output size depends on the material.
+// Managed modes keep bitrate within bounds with libvorbis bit reservoir, for clients with limited bandwidth:
+//   Mode_Average  - nominal bitrate in average, optionally hard limited by minimum and maximum
+//   Mode_Constant - minimum, nominal and maximum bitrates are the same
+// Bitrates are in kbit/s, -1 means not set.
+class EncoderSettings
+{
+public:
+	enum Mode
+	{
+		Mode_Quality  = 0,
+		Mode_Average  = 1,
+		Mode_Constant = 2
+	};
+
+	EncoderSettings();
+
+	static EncoderSettings fromQuality( qreal quality );
+	static EncoderSettings fromAverageBitrate( int nominalBitrate, int minimumBitrate = -1, int maximumBitrate = -1 );
+	static EncoderSettings fromConstantBitrate( int bitrate );
+
+	static QString nameForMode( Mode mode );
+	static Mode modeForName( const QString & name, bool * isValid = 0 );
+
+	bool isManaged() const;
+	bool isValid() const;
+
+	// expected output bitrate in kbit/s for 44.1kHz stereo
+	int expectedBitrate() const;
+
+	// initializes vi for encoding, returns false if libvorbis does not support such setup
+	bool initVorbisInfo( vorbis_info * vi, int channels, long frequency ) const;
+
+	bool operator==( const EncoderSettings & other ) const;
+	bool operator!=( const EncoderSettings & other ) const;
+
+	Mode mode;
+	qreal quality;
+	int minimumBitrate;
+	int nominalBitrate;
+	int maximumBitrate;
+};
+
+
+QDataStream & operator<<( QDataStream & stream, const EncoderSettings & settings );
+QDataStream & operator>>( QDataStream & stream, EncoderSettings & settings );
+
+
+
+
+inline bool EncoderSettings::isManaged() const
+{ return mode != Mode_Quality; }
+
+inline bool EncoderSettings::operator!=( const EncoderSettings & other ) const
+{ return !operator==( other ); }
+
+
+
+
+} // namespace Fogg
@@ -0,0 +1,121 @@
+#include "EncoderSetupCache.h"
+
+#include <QThreadStorage>
+
+#include <vorbis/vorbisenc.h>
+
+
+
+
+namespace Fogg {
+
+
+
+
+// enough for a batch that alternates between a few source formats
+static const int kMaximumSetupCount = 4;
+
+static QThreadStorage<EncoderSetupCache*> encoderSetupCacheForThread;
+
+
+
+
+EncoderSetupCache::Setup::Setup( const EncoderSettings & settings, const int channels, const long frequency )
+{
+	settings_ = settings;
+	channels_ = channels;
+	frequency_ = frequency;
+
+	vorbis_info_init( &info_ );
+	isValid_ = settings_.initVorbisInfo( &info_, channels_, frequency_ );
+}
+
+
+EncoderSetupCache::Setup::~Setup()
+{
+	vorbis_info_clear( &info_ );
+}
+
+
+void EncoderSetupCache::Setup::_fillPacket( const QByteArray & data, const ogg_int64_t packetNumber,
+		ogg_packet * const packet )
+{
+	packet->packet = reinterpret_cast<unsigned char*>( const_cast<char*>( data.constData() ) );
+	packet->bytes = data.size();
+	packet->b_o_s = packetNumber == 0 ? 1 : 0;
+	packet->e_o_s = 0;
+	packet->granulepos = 0;
+	packet->packetno = packetNumber;
+}
+
+
+void EncoderSetupCache::Setup::headerOut( vorbis_dsp_state * const vd, vorbis_comment * const vc,
+		ogg_packet * const header, ogg_packet * const headerComment, ogg_packet * const headerCode )
+{
+	if ( identificationHeader_.isEmpty() )
+	{
+		// comment packet is owned by vd, caller gets its own copy below
+		ogg_packet dspHeaderComment;
+		vorbis_analysis_headerout( vd, vc, header, &dspHeaderComment, headerCode );
+
+		identificationHeader_ = QByteArray( reinterpret_cast<const char*>( header->packet ), header->bytes );
+		codebookHeader_ = QByteArray( reinterpret_cast<const char*>( headerCode->packet ), headerCode->bytes );
+	}
+
+	_fillPacket( identificationHeader_, 0, header );
+	vorbis_commentheader_out( vc, headerComment );
+	_fillPacket( codebookHeader_, 2, headerCode );
+}
+
+
+
+
+EncoderSetupCache::EncoderSetupCache()
+{
+}
+
+
+EncoderSetupCache::~EncoderSetupCache()
+{
+	foreach ( Setup * const setup, setups_ )
+		delete setup;
+}
+
+
+EncoderSetupCache::Setup * EncoderSetupCache::setupForCurrentThread( const EncoderSettings & settings,
+		const int channels, const long frequency )
+{
+	if ( !encoderSetupCacheForThread.hasLocalData() )
+		encoderSetupCacheForThread.setLocalData( new EncoderSetupCache );
+
+	return encoderSetupCacheForThread.localData()->_setup( settings, channels, frequency );
+}
+
+
+EncoderSetupCache::Setup * EncoderSetupCache::_setup( const EncoderSettings & settings,
+		const int channels, const long frequency )
+{
+	for ( int i = 0; i < setups_.count(); ++i )
+	{
+		Setup * const setup = setups_.at( i );
+		if ( setup->settings_ == settings && setup->channels_ == channels && setup->frequency_ == frequency )
+		{
+			setups_.move( i, 0 );
+			return setup->isValid_ ? setup : 0;
+		}
+	}
+
+	// unsupported parameters are cached too, so libvorbis is not asked for them again
+	Setup * const setup = new Setup( settings, channels, frequency );
+
+	if ( setups_.count() == kMaximumSetupCount )
+		delete setups_.takeLast();
+	setups_.prepend( setup );
+
+	return setup->isValid_ ? setup : 0;
+}
+
+
+
+
+} // namespace Fogg
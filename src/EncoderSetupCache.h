@@ -0,0 +1,85 @@
+
+#pragma once
+
+#include <QList>
+#include <QByteArray>
+
+#include <vorbis/codec.h>
+
+#include "EncoderSettings.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+// Keeps Vorbis encoder setups of recent jobs for each thread, so a batch of short files with the same
+// parameters does not evaluate encoder setup, build codebooks and pack setup headers for every file.
+// libvorbis builds encoder codebooks into vorbis_info on the first vorbis_analysis_init() and
+// later encoders reuse them, vorbis_info itself stays unchanged while encoding.
+// Setups are never shared between threads, so no locking is needed.
+class EncoderSetupCache
+{
+public:
+	class Setup
+	{
+	public:
+		vorbis_info * info();
+
+		// Same as vorbis_analysis_headerout(), but identification and codebook headers are packed once per setup.
+		// Header packets stay valid while setup does, comment packet must be freed with ogg_packet_clear().
+		void headerOut( vorbis_dsp_state * vd, vorbis_comment * vc,
+				ogg_packet * header, ogg_packet * headerComment, ogg_packet * headerCode );
+
+	private:
+		Setup( const EncoderSettings & settings, int channels, long frequency );
+		~Setup();
+
+		Setup( const Setup & );
+		Setup & operator=( const Setup & );
+
+		static void _fillPacket( const QByteArray & data, ogg_int64_t packetNumber, ogg_packet * packet );
+
+	private:
+		EncoderSettings settings_;
+		int channels_;
+		long frequency_;
+
+		vorbis_info info_;
+		bool isValid_;
+
+		QByteArray identificationHeader_;
+		QByteArray codebookHeader_;
+
+		friend class EncoderSetupCache;
+	};
+
+	// Returns setup from the current thread cache, or 0 if libvorbis does not support such parameters.
+	// Setup stays valid until the thread asks for a setup with other parameters several times.
+	static Setup * setupForCurrentThread( const EncoderSettings & settings, int channels, long frequency );
+
+	~EncoderSetupCache();
+
+private:
+	EncoderSetupCache();
+
+	Setup * _setup( const EncoderSettings & settings, int channels, long frequency );
+
+private:
+	// most recently used first
+	QList<Setup*> setups_;
+};
+
+
+
+
+inline vorbis_info * EncoderSetupCache::Setup::info()
+{ return &info_; }
+
+
+
+
+} // namespace Fogg
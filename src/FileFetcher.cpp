@@ -3,8 +3,16 @@
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QDirIterator>
+
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
 
 #include "Global.h"
+#include "ScanIndex.h"
 
 
 
@@ -14,10 +22,18 @@ namespace Fogg {
 
 
 
+// directories are scanned on several threads, it pays off on network mounts even with few cores
+static const int kMinimumScanThreadCount = 2;
+static const int kMaximumScanThreadCount = 8;
+
+
+
+
 FileFetcher::FileFetcher( QObject * const parent ) :
 	QObject( parent )
 {
 	isRunning_ = false;
+	scanIndex_ = 0;
 
 	thread_ = new FileFetcherThread( this );
 }
@@ -45,6 +61,14 @@ void FileFetcher::setFilters( const QStringList & filters )
 }
 
 
+void FileFetcher::setScanIndex( ScanIndex * const scanIndex )
+{
+	Q_ASSERT( !isRunning() );
+
+	scanIndex_ = scanIndex;
+}
+
+
 void FileFetcher::start()
 {
 	Q_ASSERT( !isRunning() );
@@ -65,6 +89,7 @@ void FileFetcher::abort()
 	{
 		QMutexLocker locker( &mutex_ );
 		isAborted_ = true;
+		scanWaiter_.wakeAll();
 		QCoreApplication::removePostedEvents( this, EventType_Fetched );
 		QCoreApplication::removePostedEvents( this, EventType_CurrentDir );
 		QCoreApplication::removePostedEvents( this, EventType_Finished );
@@ -85,12 +110,7 @@ bool FileFetcher::event( QEvent * const e )
 		Q_ASSERT( !isAborted_ );
 		Q_ASSERT( isRunning_ );
 		const FetchedEvent * const fetchEvent = static_cast<const FetchedEvent*>( e );
-		foreach ( const QString & filePath, fetchEvent->filePaths )
-		{
-			emit fetched( filePath, fetchEvent->basePath, fetchEvent->isExtensionRecognized );
-			if ( isAborted_ )
-				break;
-		}
+		emit fetched( fetchEvent->filePaths, fetchEvent->basePath, fetchEvent->isExtensionRecognized );
 	}
 		return true;
 
@@ -187,34 +207,181 @@ void FileFetcher::_processUrls()
 		}
 	}
 
-	while ( !pathsToSearch.isEmpty() )
+	if ( pathsToSearch.isEmpty() )
+		return;
+
 	{
-		if ( isAborted_ )
-			return;
+		QMutexLocker locker( &mutex_ );
+		pathsToSearch_ = pathsToSearch;
+		busyScanThreadCount_ = 0;
+	}
+
+	// this thread scans as well
+	const int scanThreadCount = qBound( kMinimumScanThreadCount, QThread::idealThreadCount(), kMaximumScanThreadCount );
+
+	QList<FileFetcherScanThread*> scanThreads;
+	for ( int i = 1; i < scanThreadCount; ++i )
+	{
+		FileFetcherScanThread * const scanThread = new FileFetcherScanThread( this );
+		scanThread->start();
+		scanThreads << scanThread;
+	}
+
+	_scan();
+
+	foreach ( FileFetcherScanThread * const scanThread, scanThreads )
+	{
+		scanThread->wait();
+		delete scanThread;
+	}
 
-		const SearchPath currentPath = pathsToSearch.takeFirst();
-		const QDir currentDir = QDir( currentPath.path );
+	pathsToSearch_.clear();
+}
+
+
+// Takes directories from the shared queue until all of them are scanned,
+// subdirectories found are put back to the queue for any scan thread to pick up.
+void FileFetcher::_scan()
+{
+	QList<QRegExp> filters;
+	foreach ( const QString & filter, filters_ )
+		filters << QRegExp( filter, Qt::CaseInsensitive, QRegExp::Wildcard );
+
+	while ( true )
+	{
+		SearchPath currentPath;
 
 		{
 			QMutexLocker locker( &mutex_ );
-			if ( isAborted_ )
+
+			while ( !isAborted_ && pathsToSearch_.isEmpty() && busyScanThreadCount_ != 0 )
+				scanWaiter_.wait( &mutex_ );
+
+			if ( isAborted_ || pathsToSearch_.isEmpty() )
+			{
+				// nothing left, wake other idle threads to let them exit too
+				scanWaiter_.wakeAll();
 				return;
+			}
+
+			currentPath = pathsToSearch_.takeFirst();
+			busyScanThreadCount_++;
+
 			QCoreApplication::postEvent( this, new CurrentDirEvent( currentPath.path ) );
 		}
 
-		foreach ( const QString & dirPath, currentDir.entryList( QDir::Dirs | QDir::NoDotAndDotDot ) )
-			pathsToSearch << SearchPath( currentPath.basePath, currentDir.absoluteFilePath( dirPath ) );
+		const QString pathPrefix = currentPath.path.endsWith( QLatin1Char( '/' ) ) ?
+				currentPath.path : currentPath.path + QLatin1Char( '/' );
+
+		QStringList dirNames;
+		QStringList fileNames;
+
+		// unchanged directory is taken from index without listing it
+		const QFileInfo dirInfo = QFileInfo( currentPath.path );
+		const qint64 modified = dirInfo.lastModified().toMSecsSinceEpoch();
+		if ( !dirInfo.exists() )
+		{
+			// removed while scanning
+		}
+		else if ( !scanIndex_ || !scanIndex_->find( currentPath.path, modified, dirNames, fileNames ) )
+		{
+			_readDir( currentPath.path, dirNames, fileNames );
+			if ( scanIndex_ )
+				scanIndex_->insert( currentPath.path, modified, dirNames, fileNames );
+		}
 
-		const QStringList fileNames = currentDir.entryList( filters_, QDir::Files );
 		QStringList filePaths;
 		foreach ( const QString & fileName, fileNames )
-			filePaths << currentDir.absoluteFilePath( fileName );
-		if ( !_postFetchEvent( currentPath.basePath, filePaths, true ) )
-			return;
+		{
+			foreach ( const QRegExp & filter, filters )
+			{
+				if ( filter.exactMatch( fileName ) )
+				{
+					filePaths << pathPrefix + fileName;
+					break;
+				}
+			}
+		}
+
+		const bool isPosted = _postFetchEvent( currentPath.basePath, filePaths, true );
+
+		{
+			QMutexLocker locker( &mutex_ );
+
+			if ( isPosted )
+			{
+				foreach ( const QString & dirName, dirNames )
+					pathsToSearch_ << SearchPath( currentPath.basePath, pathPrefix + dirName );
+			}
+
+			busyScanThreadCount_--;
+			scanWaiter_.wakeAll();
+		}
 	}
 }
 
 
+// Reads directory entries only once, entry types are taken from the directory itself when possible,
+// so regular files and directories are not stat'ed one by one. Hidden entries are skipped like QDir does.
+// Names are sorted like QDir::Name | QDir::IgnoreCase did, so files of each directory are fetched in stable order.
+// Directories are scanned by several threads though, so batches of different directories arrive in any order.
+void FileFetcher::_readDir( const QString & dirPath, QStringList & dirNames, QStringList & fileNames )
+{
+#ifdef Q_OS_UNIX
+	const QByteArray encodedDirPath = QFile::encodeName( dirPath );
+	DIR * const dir = opendir( encodedDirPath.constData() );
+	if ( !dir )
+		return;
+
+	while ( const struct dirent * const entry = readdir( dir ) )
+	{
+		if ( entry->d_name[ 0 ] == '.' )
+			continue;
+
+		bool isDir = false;
+		bool isFile = false;
+
+#ifdef _DIRENT_HAVE_D_TYPE
+		if ( entry->d_type == DT_DIR )
+			isDir = true;
+		else if ( entry->d_type == DT_REG )
+			isFile = true;
+		else if ( entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN )
+#endif
+		{
+			// symbolic links are followed, some file systems do not report types at all
+			struct stat entryStat;
+			const QByteArray entryPath = encodedDirPath + '/' + entry->d_name;
+			if ( stat( entryPath.constData(), &entryStat ) == 0 )
+			{
+				isDir = S_ISDIR( entryStat.st_mode );
+				isFile = S_ISREG( entryStat.st_mode );
+			}
+		}
+
+		if ( isDir )
+			dirNames << QFile::decodeName( entry->d_name );
+		else if ( isFile )
+			fileNames << QFile::decodeName( entry->d_name );
+	}
+
+	closedir( dir );
+#else
+	for ( QDirIterator it( dirPath, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot ); it.hasNext(); )
+	{
+		it.next();
+		if ( it.fileInfo().isDir() )
+			dirNames << it.fileName();
+		else
+			fileNames << it.fileName();
+	}
+#endif
+
+	dirNames.sort( Qt::CaseInsensitive );
+	fileNames.sort( Qt::CaseInsensitive );
+}
+
+
 bool FileFetcher::_postFetchEvent( const QString & basePath, const QStringList & filePaths, const bool isExtensionRecognized )
 {
 	if ( filePaths.isEmpty() )
@@ -247,4 +414,18 @@ void FileFetcherThread::run()
 
 
 
+FileFetcherScanThread::FileFetcherScanThread( FileFetcher * const fileFetcher ) :
+	fileFetcher_( fileFetcher )
+{
+}
+
+
+void FileFetcherScanThread::run()
+{
+	fileFetcher_->_scan();
+}
+
+
+
+
 } // namespace Fogg
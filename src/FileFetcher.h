@@ -7,6 +7,7 @@
 #include <QWaitCondition>
 #include <QStringList>
 #include <QUrl>
+#include <QRegExp>
 
 
 
@@ -17,6 +18,8 @@ namespace Fogg {
 
 
 class FileFetcherThread;
+class FileFetcherScanThread;
+class ScanIndex;
 
 
 
@@ -42,6 +45,9 @@ public:
 	QStringList filters() const;
 	void setFilters( const QStringList & filters );
 
+	ScanIndex * scanIndex() const;
+	void setScanIndex( ScanIndex * scanIndex );
+
 	bool isRunning() const;
 
 public slots:
@@ -50,7 +56,7 @@ public slots:
 
 signals:
 	void currentDirChanged( const QString & dirPath );
-	void fetched( const QString & filePath, const QString & basePath, bool extensionRecognized );
+	void fetched( const QStringList & filePaths, const QString & basePath, bool extensionRecognized );
 	void finished();
 
 protected:
@@ -102,9 +108,14 @@ private:
 	void _processUrls();
 	bool _postFetchEvent( const QString & basePath, const QStringList & filePaths, bool isExtensionRecognized );
 
+	// called from FileFetcherThread and all FileFetcherScanThread instances
+	void _scan();
+	static void _readDir( const QString & dirPath, QStringList & dirNames, QStringList & fileNames );
+
 private:
 	QList<QUrl> urls_;
 	QStringList filters_;
+	ScanIndex * scanIndex_;
 
 	bool isRunning_;
 	FileFetcherThread * thread_;
@@ -112,7 +123,13 @@ private:
 	mutable QWaitCondition waiter_;
 	bool isAborted_;
 
+	// directories shared by all scan threads, guarded by mutex_
+	QList<SearchPath> pathsToSearch_;
+	int busyScanThreadCount_;
+	QWaitCondition scanWaiter_;
+
 	friend class FileFetcherThread;
+	friend class FileFetcherScanThread;
 };
 
 
@@ -138,6 +155,26 @@ private:
 
 
 
+class FileFetcherScanThread : public QThread
+{
+	Q_OBJECT
+
+private:
+	FileFetcherScanThread( FileFetcher * fileFetcher );
+
+protected:
+	// reimplemented from QThread
+	void run();
+
+private:
+	FileFetcher * fileFetcher_;
+
+	friend class FileFetcher;
+};
+
+
+
+
 inline bool FileFetcher::isRunning() const
 { return isRunning_; }
 
@@ -147,6 +184,9 @@ inline QList<QUrl> FileFetcher::urls() const
 inline QStringList FileFetcher::filters() const
 { return filters_; }
 
+inline ScanIndex * FileFetcher::scanIndex() const
+{ return scanIndex_; }
+
 
 
 
@@ -28,6 +28,14 @@ namespace Fogg {
 static const qreal kMinimumQualityValue = -0.1;
 static const qreal kMaximumQualityValue =  1.0;
 
+// managed bitrate range in kbit/s, libvorbis narrows it further depending on channels and frequency
+static const int kMinimumBitrateValue = 32;
+static const int kMaximumBitrateValue = 500;
+
+// resampling target range in Hz, as supported by Vorbis encoder
+static const int kMinimumSampleRateValue = 8000;
+static const int kMaximumSampleRateValue = 192000;
+
 extern const QString kLogoFilePath;
 extern const QString kLicenseFilePath;
 
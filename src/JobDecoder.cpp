@@ -0,0 +1,129 @@
+
+#include "JobDecoder.h"
+
+#include <QVarLengthArray>
+#include <QIODevice>
+
+#include <grim/audio/FormatPlugin.h>
+
+#include "Deinterleaver.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+JobDecoder::JobDecoder( Grim::Audio::FormatFile * const sourceAudioFile, const int blockSampleCount,
+		QObject * const parent ) :
+	QThread( parent ),
+	freeBlocks_( kBlockCount )
+{
+	sourceAudioFile_ = sourceAudioFile;
+	blockSampleCount_ = blockSampleCount;
+
+	for ( int i = 0; i < kBlockCount; ++i )
+		blocks_[ i ].samples.resize( sourceAudioFile_->channels() * blockSampleCount_ );
+
+	readIndex_ = 0;
+	writeIndex_ = 0;
+}
+
+
+JobDecoder::~JobDecoder()
+{
+	abort();
+	wait();
+}
+
+
+const JobDecoder::Block & JobDecoder::acquireBlock()
+{
+	readyBlocks_.acquire();
+	return blocks_[ readIndex_ ];
+}
+
+
+void JobDecoder::releaseBlock()
+{
+	readIndex_ = (readIndex_ + 1) % kBlockCount;
+	freeBlocks_.release();
+}
+
+
+void JobDecoder::abort()
+{
+	isAborted_.storeRelease( 1 );
+
+	// wake decoder if it waits for a free block
+	freeBlocks_.release();
+}
+
+
+void JobDecoder::run()
+{
+	const int channelCount = sourceAudioFile_->channels();
+	const Deinterleaver::Kernel deinterleave = Deinterleaver::kernel( channelCount, sourceAudioFile_->bitsPerSample() );
+
+	QByteArray sourceBuffer;
+	sourceBuffer.resize( sourceAudioFile_->samplesToBytes( blockSampleCount_ ) );
+
+	const bool canReadFloat = sourceAudioFile_->canReadFloat();
+
+	QVarLengthArray<float*,Deinterleaver::kMaxChannelCount> channelData( channelCount );
+
+	while ( true )
+	{
+		freeBlocks_.acquire();
+		if ( isAborted_.loadAcquire() )
+			break;
+
+		Block & block = blocks_[ writeIndex_ ];
+		writeIndex_ = (writeIndex_ + 1) % kBlockCount;
+
+		for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+			channelData[ channelIndex ] = block.samples.data() + channelIndex*blockSampleCount_;
+
+		if ( canReadFloat )
+		{
+			// float decoders write planar samples into block directly
+			block.sampleCount = int(sourceAudioFile_->readFloat( channelData.constData(), blockSampleCount_ ));
+		}
+		else
+		{
+			qint64 bytes;
+			const char * sourceData = sourceAudioFile_->readView( sourceBuffer.size(), bytes );
+			if ( !sourceData && bytes != -1 )
+			{
+				bytes = sourceAudioFile_->device()->read( sourceBuffer.data(), sourceBuffer.size() );
+				sourceData = sourceBuffer.constData();
+			}
+
+			if ( bytes == -1 )
+			{
+				block.sampleCount = -1;
+			}
+			else
+			{
+				block.sampleCount = int(sourceAudioFile_->bytesToSamples( bytes ));
+				deinterleave( sourceData, channelData.constData(), block.sampleCount, channelCount );
+			}
+		}
+
+		block.sourcePosition = sourceAudioFile_->device()->pos();
+
+		const bool isFinished = block.sampleCount <= 0;
+
+		readyBlocks_.release();
+
+		if ( isFinished )
+			break;
+	}
+}
+
+
+
+
+} // namespace Fogg
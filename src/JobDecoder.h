@@ -0,0 +1,87 @@
+
+#pragma once
+
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QVector>
+
+
+
+
+namespace Grim {
+namespace Audio {
+	class FormatFile;
+}
+}
+
+
+
+
+namespace Fogg {
+
+
+
+
+// Decodes Job source file in a separate thread into planar float blocks,
+// so decoding overlaps with encoding.
+// Blocks are passed thru the ring, where Job thread is the only consumer.
+class JobDecoder : public QThread
+{
+public:
+	class Block
+	{
+	public:
+		Block() :
+			sampleCount( 0 ), sourcePosition( 0 )
+		{}
+
+		// planar samples, blockSampleCount() floats for each channel
+		QVector<float> samples;
+
+		// 0 means end of source, -1 means read error
+		int sampleCount;
+
+		// source device position after this block was read
+		qint64 sourcePosition;
+	};
+
+	JobDecoder( Grim::Audio::FormatFile * sourceAudioFile, int blockSampleCount, QObject * parent = 0 );
+	~JobDecoder();
+
+	int blockSampleCount() const;
+
+	const Block & acquireBlock();
+	void releaseBlock();
+
+	void abort();
+
+protected:
+	// reimplemented from QThread
+	void run();
+
+private:
+	static const int kBlockCount = 4;
+
+	Grim::Audio::FormatFile * sourceAudioFile_;
+	int blockSampleCount_;
+
+	Block blocks_[ kBlockCount ];
+	int readIndex_;
+	int writeIndex_;
+
+	QSemaphore freeBlocks_;
+	QSemaphore readyBlocks_;
+	QAtomicInt isAborted_;
+};
+
+
+
+
+inline int JobDecoder::blockSampleCount() const
+{ return blockSampleCount_; }
+
+
+
+
+} // namespace Fogg
@@ -69,7 +69,6 @@ JobItemModel::DirItem::DirItem() :
 void JobItemModel::DirItem::addChildItem( Item * const item )
 {
 	Q_ASSERT( !item->parentItem );
-	Q_ASSERT( !childItems.contains( item ) );
 
 	const int itemWeight = item->weight();
 	const int newTotalWeight = totalWeight + itemWeight;
@@ -87,6 +86,9 @@ void JobItemModel::DirItem::addChildItem( Item * const item )
 	item->parentItem = this;
 	item->row = childItems.count() - 1;
 
+	if ( !childItemForName.contains( item->name ) )
+		childItemForName[ item->name ] = item;
+
 	if ( parentItem )
 		parentItem->asDir()->childItemChanged( this, wasWeight, wasProgress );
 }
@@ -95,7 +97,7 @@ void JobItemModel::DirItem::addChildItem( Item * const item )
 void JobItemModel::DirItem::removeChildItem( Item * const item )
 {
 	Q_ASSERT( item->parentItem == this );
-	Q_ASSERT( childItems.contains( item ) );
+	Q_ASSERT( childItems.at( item->row ) == item );
 
 	const int itemWeight = item->weight();
 	const int newTotalWeight = totalWeight - itemWeight;
@@ -115,10 +117,13 @@ void JobItemModel::DirItem::removeChildItem( Item * const item )
 		childItems[ i ]->row--;
 	}
 
-	childItems.removeOne( item );
+	childItems.removeAt( item->row );
 	item->parentItem = 0;
 	item->row = -1;
 
+	if ( childItemForName.value( item->name ) == item )
+		childItemForName.remove( item->name );
+
 	if ( parentItem )
 		parentItem->asDir()->childItemChanged( this, wasWeight, wasProgress );
 }
@@ -127,7 +132,7 @@ void JobItemModel::DirItem::removeChildItem( Item * const item )
 void JobItemModel::DirItem::childItemChanged( const Item * const item, const int wasWeight, const qreal wasProgress )
 {
 	Q_ASSERT( item->parentItem == this );
-	Q_ASSERT( childItems.contains( const_cast<Item*>( item ) ) );
+	Q_ASSERT( childItems.at( item->row ) == item );
 
 	const int itemWeight = item->weight();
 	const int newTotalWeight = totalWeight + itemWeight - wasWeight;
@@ -157,11 +162,13 @@ void JobItemModel::DirItem::clearChildItems()
 		{
 			itemsToDestroy << item->asDir()->childItems;
 			item->asDir()->childItems.clear();
+			item->asDir()->childItemForName.clear();
 		}
 		item->destroy();
 	}
 
 	childItems.clear();
+	childItemForName.clear();
 
 	const int wasWeight = totalWeight;
 	const qreal wasProgress = totalProgress;
@@ -176,10 +183,7 @@ void JobItemModel::DirItem::clearChildItems()
 
 JobItemModel::Item * JobItemModel::DirItem::findChildItemByName( const QString & name ) const
 {
-	foreach ( Item * const item, childItems )
-		if ( item->name == name )
-			return item;
-	return 0;
+	return childItemForName.value( name );
 }
 
 
@@ -190,6 +194,13 @@ JobItemModel::FileItem::FileItem() :
 {
 	jobId = 0;
 	conversionProgress = 0;
+
+	for ( int i = 0; i < FileItemList_TotalLists; ++i )
+	{
+		previousInList[ i ] = 0;
+		nextInList[ i ] = 0;
+		isInList[ i ] = false;
+	}
 }
 
 
@@ -207,8 +218,77 @@ int JobItemModel::progressToPercents( const qreal progress )
 }
 
 
+JobItemModel::FileItemList::FileItemList( const FileItemListType type ) :
+	type_( type )
+{
+	firstItem_ = 0;
+	lastItem_ = 0;
+	count_ = 0;
+}
+
+
+QList<const JobItemModel::FileItem*> JobItemModel::FileItemList::toList() const
+{
+	QList<const FileItem*> items;
+	items.reserve( count_ );
+	for ( const FileItem * item = firstItem_; item; item = item->nextInList[ type_ ] )
+		items << item;
+	return items;
+}
+
+
+void JobItemModel::FileItemList::append( FileItem * const item )
+{
+	Q_ASSERT( !item->isInList[ type_ ] );
+
+	item->previousInList[ type_ ] = lastItem_;
+	item->nextInList[ type_ ] = 0;
+	item->isInList[ type_ ] = true;
+
+	if ( lastItem_ )
+		lastItem_->nextInList[ type_ ] = item;
+	else
+		firstItem_ = item;
+	lastItem_ = item;
+
+	count_++;
+}
+
+
+void JobItemModel::FileItemList::remove( FileItem * const item )
+{
+	Q_ASSERT( item->isInList[ type_ ] );
+
+	FileItem * const previousItem = item->previousInList[ type_ ];
+	FileItem * const nextItem = item->nextInList[ type_ ];
+
+	if ( previousItem )
+		previousItem->nextInList[ type_ ] = nextItem;
+	else
+		firstItem_ = nextItem;
+
+	if ( nextItem )
+		nextItem->previousInList[ type_ ] = previousItem;
+	else
+		lastItem_ = previousItem;
+
+	item->previousInList[ type_ ] = 0;
+	item->nextInList[ type_ ] = 0;
+	item->isInList[ type_ ] = false;
+
+	count_--;
+}
+
+
+
+
 JobItemModel::JobItemModel( QObject * parent ) :
-	QAbstractItemModel( parent )
+	QAbstractItemModel( parent ),
+	allFileItems_( FileItemList_All ),
+	allInactiveFileItems_( FileItemList_Inactive ),
+	allUnfinishedFileItems_( FileItemList_Unfinished ),
+	allInactiveUnfinishedFileItems_( FileItemList_InactiveUnfinished ),
+	allActiveFileItems_( FileItemList_Active )
 {
 	rootItem_ = new DirItem;
 }
@@ -275,6 +355,8 @@ QString JobItemModel::_nameForJobResult( const int result )
 		return tr( "Read error" );
 	case Converter::JobResult_WriteError:
 		return tr( "Write error" );
+	case Converter::JobResult_UpToDate:
+		return tr( "Skipped (up to date)" );
 	}
 
 	return tr( "Unknown" );
@@ -316,6 +398,9 @@ QModelIndex JobItemModel::_indexForItem( Item * const item, const int column ) c
 
 void JobItemModel::_setItemName( Item * const item, const QString & name )
 {
+	// name is a key in parent lookup hash
+	Q_ASSERT( !item->parentItem );
+
 	item->name = name;
 	item->modelName = QVariant();
 }
@@ -343,23 +428,23 @@ void JobItemModel::_setItemStateAndResult( Item * const item, const StateType st
 		if ( wasFinished && item->result == Converter::JobResult_Null )
 		{
 			Q_ASSERT( !allUnfinishedFileItems().contains( item->asFile() ) );
-			allUnfinishedFileItems_ << item->asFile();
+			allUnfinishedFileItems_.append( item->asFile() );
 
 			if ( item->asFile()->jobId == 0 )
 			{
 				Q_ASSERT( !allInactiveUnfinishedFileItems().contains( item->asFile() ) );
-				allInactiveUnfinishedFileItems_ << item->asFile();
+				allInactiveUnfinishedFileItems_.append( item->asFile() );
 			}
 		}
 		else if ( !wasFinished && item->result != Converter::JobResult_Null )
 		{
 			Q_ASSERT( allUnfinishedFileItems().contains( item->asFile() ) );
-			allUnfinishedFileItems_.removeOne( item->asFile() );
+			allUnfinishedFileItems_.remove( item->asFile() );
 
 			if ( item->asFile()->jobId == 0 )
 			{
 				Q_ASSERT( allInactiveUnfinishedFileItems().contains( item->asFile() ) );
-				allInactiveUnfinishedFileItems_.removeOne( item->asFile() );
+				allInactiveUnfinishedFileItems_.remove( item->asFile() );
 			}
 		}
 	}
@@ -593,9 +678,36 @@ QString JobItemModel::_evaluateRelativeDestinationPathForFile( const QString & f
 }
 
 
-JobItemModel::DirItem * JobItemModel::_constructDirItem( const QString & dirName, DirItem * const parentDirItem )
+JobItemModel::Item * JobItemModel::_findChildItem( DirItem * const dirItem, const QString & name,
+		const PendingItems & pendingItems ) const
+{
+	Item * const item = dirItem->findChildItemByName( name );
+	if ( item || pendingItems.newDirItems.contains( dirItem ) )
+		return item;
+	return pendingItems.childItemForParentDirItemAndName.value( qMakePair( dirItem, name ) );
+}
+
+
+void JobItemModel::_addChildItem( DirItem * const dirItem, Item * const item, PendingItems & pendingItems )
+{
+	if ( pendingItems.newDirItems.contains( dirItem ) )
+	{
+		dirItem->addChildItem( item );
+		return;
+	}
+
+	if ( !pendingItems.childItemsForParentDirItem.contains( dirItem ) )
+		pendingItems.parentDirItems << dirItem;
+
+	pendingItems.childItemsForParentDirItem[ dirItem ] << item;
+	pendingItems.childItemForParentDirItemAndName[ qMakePair( dirItem, item->name ) ] = item;
+}
+
+
+JobItemModel::DirItem * JobItemModel::_constructDirItem( const QString & dirName, DirItem * const parentDirItem,
+		PendingItems & pendingItems )
 {
-	Item * item = parentDirItem->findChildItemByName( dirName );
+	Item * item = _findChildItem( parentDirItem, dirName, pendingItems );
 	if ( item )
 	{
 		if ( item->type != Item_Dir )
@@ -606,10 +718,8 @@ JobItemModel::DirItem * JobItemModel::_constructDirItem( const QString & dirName
 	DirItem * dirItem = new DirItem;
 	_setItemName( dirItem, dirName );
 
-	const int dirItemIndex = parentDirItem->childItems.count();
-	beginInsertRows( _indexForItem( parentDirItem, 0 ), dirItemIndex, dirItemIndex );
-	parentDirItem->addChildItem( dirItem );
-	endInsertRows();
+	_addChildItem( parentDirItem, dirItem, pendingItems );
+	pendingItems.newDirItems << dirItem;
 
 	return dirItem;
 }
@@ -617,11 +727,9 @@ JobItemModel::DirItem * JobItemModel::_constructDirItem( const QString & dirName
 
 JobItemModel::FileItem * JobItemModel::_constructFileItem( const QString & fileName, DirItem * const parentDirItem,
 		const QString & sourcePath, const QString & basePath, const QString & format,
-		const QString & relativeDestinationPath, bool & isAdded )
+		const QString & relativeDestinationPath, PendingItems & pendingItems )
 {
-	isAdded = false;
-
-	Item * const existedItem = parentDirItem->findChildItemByName( fileName );
+	Item * const existedItem = _findChildItem( parentDirItem, fileName, pendingItems );
 	if ( existedItem )
 	{
 		if ( existedItem->type == Item_Dir )
@@ -638,23 +746,17 @@ JobItemModel::FileItem * JobItemModel::_constructFileItem( const QString & fileN
 
 	_setItemName( fileItem, fileName );
 
-	const int fileItemIndex = parentDirItem->childItems.count();
-	beginInsertRows( _indexForItem( parentDirItem, 0 ), fileItemIndex, fileItemIndex );
-
-	parentDirItem->addChildItem( fileItem );
-
 	fileItem->sourcePath = sourcePath;
 	fileItem->format = format;
 	fileItem->relativeDestinationPath = relativeDestinationPath;
 
-	allFileItems_ << fileItem;
-	allInactiveFileItems_ << fileItem;
-	allUnfinishedFileItems_ << fileItem;
-	allInactiveUnfinishedFileItems_ << fileItem;
+	_addChildItem( parentDirItem, fileItem, pendingItems );
 
-	endInsertRows();
+	allFileItems_.append( fileItem );
+	allInactiveFileItems_.append( fileItem );
+	allUnfinishedFileItems_.append( fileItem );
+	allInactiveUnfinishedFileItems_.append( fileItem );
 
-	isAdded = true;
 	return fileItem;
 }
 
@@ -678,29 +780,29 @@ void JobItemModel::_cleanupCachedItems( const QList<Item*> & items, const bool e
 			aboutToRemoveFileItem_ = 0;
 
 			Q_ASSERT( allFileItems().contains( item->asFile() ) );
-			allFileItems_.removeOne( item->asFile() );
+			allFileItems_.remove( item->asFile() );
 
 			if ( item->asFile()->jobId != 0 )
 			{
 				fileItemForJobId_.remove( item->asFile()->jobId );
 				Q_ASSERT( allActiveFileItems().contains( item->asFile() ) );
-				allActiveFileItems_.removeOne( item->asFile() );
+				allActiveFileItems_.remove( item->asFile() );
 			}
 			else
 			{
 				Q_ASSERT( allInactiveFileItems().contains( item->asFile() ) );
-				allInactiveFileItems_.removeOne( item->asFile() );
+				allInactiveFileItems_.remove( item->asFile() );
 			}
 
 			if ( item->asFile()->result == Converter::JobResult_Null )
 			{
 				Q_ASSERT( allUnfinishedFileItems().contains( item->asFile() ) );
-				allUnfinishedFileItems_.removeOne( item->asFile() );
+				allUnfinishedFileItems_.remove( item->asFile() );
 
 				if ( item->asFile()->jobId == 0 )
 				{
 					Q_ASSERT( allInactiveUnfinishedFileItems().contains( item->asFile() ) );
-					allInactiveUnfinishedFileItems_.removeOne( item->asFile() );
+					allInactiveUnfinishedFileItems_.remove( item->asFile() );
 				}
 				else
 				{
@@ -758,49 +860,69 @@ const JobItemModel::Item * JobItemModel::itemForIndex( const QModelIndex & index
   Returns added index for Column_Name on success.
   */
 
-QModelIndex JobItemModel::addFile( const QString & filePath, const QString & basePath, const QString & format, bool & isAdded )
+QVector<QModelIndex> JobItemModel::addFiles( const QVector<FetchedFile> & files )
 {
-	isAdded = false;
+	PendingItems pendingItems;
+	QVector<FileItem*> fileItems( files.count(), 0 );
 
-	const QString relativeDestinationFilePath = _evaluateRelativeDestinationPathForFile( filePath, basePath );
+	for ( int i = 0; i < files.count(); ++i )
+	{
+		const FetchedFile & file = files.at( i );
 
-	const QFileInfo relativeDestinationFileInfo = QFileInfo( relativeDestinationFilePath );
+		const QString relativeDestinationFilePath = _evaluateRelativeDestinationPathForFile( file.filePath, file.basePath );
 
-	QStringList dirChain;
-	QString lastDirPath;
-	for ( QDir dir = relativeDestinationFileInfo.dir(); ; )
-	{
-		const QString dirPath = dir.path();
-		const QFileInfo pathInfo = QFileInfo( dirPath );
-		const QString dirName = pathInfo.fileName();
+		const QFileInfo relativeDestinationFileInfo = QFileInfo( relativeDestinationFilePath );
 
-		if ( dirName == "." || dirName.isEmpty() || dirPath == lastDirPath )
-			break;
+		QStringList dirChain;
+		QString lastDirPath;
+		for ( QDir dir = relativeDestinationFileInfo.dir(); ; )
+		{
+			const QString dirPath = dir.path();
+			const QFileInfo pathInfo = QFileInfo( dirPath );
+			const QString dirName = pathInfo.fileName();
 
-		dirChain.prepend( dirName );
-		lastDirPath = dirPath;
+			if ( dirName == "." || dirName.isEmpty() || dirPath == lastDirPath )
+				break;
+
+			dirChain.prepend( dirName );
+			lastDirPath = dirPath;
+
+			dir = pathInfo.dir();
+		}
+
+		DirItem * currentDirItem = rootItem_;
+		foreach ( const QString & dirName, dirChain )
+		{
+			currentDirItem = _constructDirItem( dirName, currentDirItem, pendingItems );
+			if ( !currentDirItem )
+				break;
+		}
 
-		dir = pathInfo.dir();
+		if ( !currentDirItem )
+			continue;
+
+		fileItems[ i ] = _constructFileItem( relativeDestinationFileInfo.fileName(), currentDirItem,
+				file.filePath, file.basePath, file.format, relativeDestinationFilePath, pendingItems );
 	}
 
-	DirItem * currentDirItem = rootItem_;
-	foreach ( const QString & dirName, dirChain )
+	// publish new items, one contiguous insert for each existing dir
+	foreach ( DirItem * const parentDirItem, pendingItems.parentDirItems )
 	{
-		DirItem * const dirItem = _constructDirItem( dirName, currentDirItem );
-		if ( !dirItem )
-			return QModelIndex();
-		currentDirItem = dirItem;
-	}
+		const QList<Item*> childItems = pendingItems.childItemsForParentDirItem.value( parentDirItem );
+		const int firstRow = parentDirItem->childItems.count();
 
-	bool isFileItemAdded;
-	FileItem * const fileItem = _constructFileItem( relativeDestinationFileInfo.fileName(), currentDirItem,
-			filePath, basePath, format, relativeDestinationFilePath, isFileItemAdded );
+		beginInsertRows( _indexForItem( parentDirItem, 0 ), firstRow, firstRow + childItems.count() - 1 );
+		foreach ( Item * const childItem, childItems )
+			parentDirItem->addChildItem( childItem );
+		endInsertRows();
+	}
 
-	if ( !fileItem )
-		return QModelIndex();
+	QVector<QModelIndex> indexes( files.count() );
+	for ( int i = 0; i < fileItems.count(); ++i )
+		if ( fileItems.at( i ) )
+			indexes[ i ] = _indexForItem( fileItems.at( i ), Column_Name );
 
-	isAdded = isFileItemAdded;
-	return _indexForItem( fileItem, Column_Name );
+	return indexes;
 }
 
 
@@ -817,15 +939,15 @@ void JobItemModel::setFileItemJobIdForIndex( const QModelIndex & index, const in
 		_changeFileItemState( fileItem, State_Null );
 
 		Q_ASSERT( allActiveFileItems().contains( fileItem ) );
-		allActiveFileItems_.removeOne( fileItem );
+		allActiveFileItems_.remove( fileItem );
 
 		Q_ASSERT( !allInactiveFileItems().contains( fileItem ) );
-		allInactiveFileItems_ << fileItem;
+		allInactiveFileItems_.append( fileItem );
 
 		if ( fileItem->result == Converter::JobResult_Null )
 		{
 			Q_ASSERT( !allInactiveUnfinishedFileItems().contains( fileItem ) );
-			allInactiveUnfinishedFileItems_ << fileItem;
+			allInactiveUnfinishedFileItems_.append( fileItem );
 		}
 	}
 	else
@@ -839,15 +961,15 @@ void JobItemModel::setFileItemJobIdForIndex( const QModelIndex & index, const in
 			fileItemForJobId_[ jobId ] = fileItem;
 
 			Q_ASSERT( !allActiveFileItems().contains( fileItem ) );
-			allActiveFileItems_ << fileItem;
+			allActiveFileItems_.append( fileItem );
 
 			Q_ASSERT( allInactiveFileItems().contains( fileItem ) );
-			allInactiveFileItems_.removeOne( fileItem );
+			allInactiveFileItems_.remove( fileItem );
 
 			if ( fileItem->result == Converter::JobResult_Null )
 			{
 				Q_ASSERT( allInactiveUnfinishedFileItems().contains( fileItem ) );
-				allInactiveUnfinishedFileItems_.removeOne( fileItem );
+				allInactiveUnfinishedFileItems_.remove( fileItem );
 			}
 		}
 	}
@@ -937,6 +1059,67 @@ void JobItemModel::setJobResolvedFormat( const int jobId, const QString & format
 }
 
 
+// Applies progress of many jobs at once, each changed ancestor is updated once
+// and dataChanged() is emitted once per parent for the range of its changed children.
+void JobItemModel::setJobsProgress( const QVector<QPair<int,qreal> > & progress )
+{
+	QList<Item*> changedItems;
+	QSet<Item*> changedItemSet;
+
+	for ( int i = 0; i < progress.count(); ++i )
+	{
+		Q_ASSERT( fileItemForJobId_.contains( progress.at( i ).first ) );
+
+		FileItem * const fileItem = fileItemForJobId_.value( progress.at( i ).first );
+		Q_ASSERT( fileItem->jobId == progress.at( i ).first );
+
+		const qreal wasProgress = fileItem->progress();
+		fileItem->conversionProgress = progress.at( i ).second;
+
+		fileItem->parentItem->childItemChanged( fileItem, 1, wasProgress );
+
+		for ( Item * item = fileItem; item && !changedItemSet.contains( item ); item = item->parentItem )
+		{
+			changedItemSet << item;
+			changedItems << item;
+		}
+	}
+
+	QHash<DirItem*,QPair<int,int> > changedRowsForParentItem;
+
+	foreach ( Item * const item, changedItems )
+	{
+		progressChangedItem_ = item;
+		emit itemProgressChanged();
+		progressChangedItem_ = 0;
+
+		_setItemProgress( item );
+
+		if ( item == rootItem_ )
+			continue;
+
+		QHash<DirItem*,QPair<int,int> >::iterator it = changedRowsForParentItem.find( item->parentItem );
+		if ( it == changedRowsForParentItem.end() )
+		{
+			changedRowsForParentItem.insert( item->parentItem, qMakePair( item->row, item->row ) );
+		}
+		else
+		{
+			it.value().first = qMin( it.value().first, item->row );
+			it.value().second = qMax( it.value().second, item->row );
+		}
+	}
+
+	for ( QHash<DirItem*,QPair<int,int> >::const_iterator it = changedRowsForParentItem.constBegin();
+			it != changedRowsForParentItem.constEnd(); ++it )
+	{
+		const QModelIndex parentIndex = _indexForItem( it.key(), 0 );
+		emit dataChanged( index( it.value().first, Column_Progress, parentIndex ),
+				index( it.value().second, Column_Progress, parentIndex ) );
+	}
+}
+
+
 void JobItemModel::setJobFinished( const int jobId, const int result )
 {
 	Q_ASSERT( fileItemForJobId_.contains( jobId ) );
@@ -944,22 +1127,22 @@ void JobItemModel::setJobFinished( const int jobId, const int result )
 	Q_ASSERT( fileItem->jobId == jobId );
 
 	Q_ASSERT( allActiveFileItems().contains( fileItem ) );
-	allActiveFileItems_.removeOne( fileItem );
+	allActiveFileItems_.remove( fileItem );
 
 	Q_ASSERT( !allInactiveFileItems().contains( fileItem ) );
-	allInactiveFileItems_ << fileItem;
+	allInactiveFileItems_.append( fileItem );
 
 	if ( fileItem->result == Converter::JobResult_Null )
 	{
 		Q_ASSERT( !allInactiveUnfinishedFileItems().contains( fileItem ) );
-		allInactiveUnfinishedFileItems_ << fileItem;
+		allInactiveUnfinishedFileItems_.append( fileItem );
 	}
 
 	fileItem->jobId = 0;
 	_changeFileItemState( fileItem, State_Null );
 	_changeFileItemResult( fileItem, result );
 
-	if ( fileItem->result == Converter::JobResult_Done )
+	if ( fileItem->result == Converter::JobResult_Done || fileItem->result == Converter::JobResult_UpToDate )
 		_changeFileItemProgress( fileItem, 1.0 );
 	else
 		_changeFileItemProgress( fileItem, fileItem->conversionProgress );
@@ -3,6 +3,10 @@
 
 #include <QAbstractItemModel>
 #include <QDir>
+#include <QVector>
+#include <QPair>
+#include <QHash>
+#include <QSet>
 
 
 
@@ -40,6 +44,16 @@ public:
 		State_Running
 	};
 
+	enum FileItemListType
+	{
+		FileItemList_All                = 0,
+		FileItemList_Inactive           = 1,
+		FileItemList_Unfinished         = 2,
+		FileItemList_InactiveUnfinished = 3,
+		FileItemList_Active             = 4,
+		FileItemList_TotalLists         = 5
+	};
+
 
 	class DirItem;
 	class FileItem;
@@ -86,6 +100,7 @@ public:
 		qreal totalProgress;
 
 		QList<Item*> childItems;
+		QHash<QString,Item*> childItemForName;
 		int totalWeight;
 
 		void addChildItem( Item * item );
@@ -112,11 +127,87 @@ public:
 
 		int jobId;
 
+		// links of the model file item lists, indexed by FileItemListType
+		FileItem * previousInList[ FileItemList_TotalLists ];
+		FileItem * nextInList[ FileItemList_TotalLists ];
+		bool isInList[ FileItemList_TotalLists ];
+
 	public:
 		qreal totalProgress() const;
 	};
 
 
+	// Intrusive list of file items in insertion order. Links are stored in items themselves,
+	// so append, remove and contains take constant time. Lists are owned by model and cannot be copied,
+	// use toList() for a snapshot.
+	class FileItemList
+	{
+	public:
+		class const_iterator
+		{
+		public:
+			const_iterator( const FileItem * const item, const FileItemListType type ) :
+				item_( item ), type_( type )
+			{}
+
+			const FileItem * operator*() const
+			{ return item_; }
+
+			const_iterator & operator++()
+			{ item_ = item_->nextInList[ type_ ]; return *this; }
+
+			bool operator==( const const_iterator & other ) const
+			{ return item_ == other.item_; }
+
+			bool operator!=( const const_iterator & other ) const
+			{ return item_ != other.item_; }
+
+		private:
+			const FileItem * item_;
+			FileItemListType type_;
+		};
+
+		FileItemList( FileItemListType type );
+
+		int count() const;
+		bool isEmpty() const;
+		bool contains( const FileItem * item ) const;
+
+		const_iterator begin() const;
+		const_iterator end() const;
+
+		// snapshot for iterating while items move between lists
+		QList<const FileItem*> toList() const;
+
+		void append( FileItem * item );
+		void remove( FileItem * item );
+
+	private:
+		Q_DISABLE_COPY( FileItemList )
+
+		FileItemListType type_;
+		FileItem * firstItem_;
+		FileItem * lastItem_;
+		int count_;
+	};
+
+
+	class FetchedFile
+	{
+	public:
+		FetchedFile()
+		{}
+
+		FetchedFile( const QString & _filePath, const QString & _basePath, const QString & _format ) :
+			filePath( _filePath ), basePath( _basePath ), format( _format )
+		{}
+
+		QString filePath;
+		QString basePath;
+		QString format;
+	};
+
+
 	static int progressToPercents( qreal progress );
 
 	JobItemModel( QObject * parent = 0 );
@@ -124,16 +215,17 @@ public:
 
 	void setSourcePaths( const QStringList & paths );
 
-	QList<const FileItem*> allFileItems() const;
-	QList<const FileItem*> allInactiveFileItems() const;
-	QList<const FileItem*> allUnfinishedFileItems() const;
-	QList<const FileItem*> allInactiveUnfinishedFileItems() const;
-	QList<const FileItem*> allActiveFileItems() const;
+	const FileItemList & allFileItems() const;
+	const FileItemList & allInactiveFileItems() const;
+	const FileItemList & allUnfinishedFileItems() const;
+	const FileItemList & allInactiveUnfinishedFileItems() const;
+	const FileItemList & allActiveFileItems() const;
 	QModelIndex indexForItem( const Item * item ) const;
 	const FileItem * fileItemForJobId( int jobId ) const;
 	const Item * itemForIndex( const QModelIndex & index ) const;
 
-	QModelIndex addFile( const QString & filePath, const QString & basePath, const QString & format, bool & isAdded );
+	// returns name column index of the file item for each fetched file, invalid if file cannot be added
+	QVector<QModelIndex> addFiles( const QVector<FetchedFile> & files );
 	void setFileItemJobIdForIndex( const QModelIndex & index, int jobId );
 	void setFileItemUnmarkedForIndex( const QModelIndex & index );
 	void setFileItemProgressForIndex( const QModelIndex & index, qreal progress );
@@ -143,6 +235,7 @@ public:
 
 	void setJobStarted( int jobId );
 	void setJobResolvedFormat( int jobId, const QString & format );
+	void setJobsProgress( const QVector<QPair<int,qreal> > & progress );
 	void setJobFinished( int jobId, int result );
 
 	const FileItem * aboutToRemoveFileItem() const;
@@ -164,6 +257,18 @@ protected:
 	bool event( QEvent * e );
 
 private:
+	// Items constructed by addFiles() before they are published.
+	// Children of newly constructed dirs are added directly, because those dirs are not in the model yet,
+	// children of existing dirs are collected to be inserted with a single beginInsertRows() per dir.
+	class PendingItems
+	{
+	public:
+		QSet<DirItem*> newDirItems;
+		QList<DirItem*> parentDirItems;
+		QHash<DirItem*,QList<Item*> > childItemsForParentDirItem;
+		QHash<QPair<DirItem*,QString>,Item*> childItemForParentDirItemAndName;
+	};
+
 	static QString _nameForColumn( ColumnType column );
 	static QString _nameForStateAndResult( StateType state, int result );
 	static QString _nameForJobResult( int result );
@@ -190,20 +295,22 @@ private:
 
 	QString _oggedFileName( const QString & filePath ) const;
 	QString _evaluateRelativeDestinationPathForFile( const QString & filePath, const QString & basePath ) const;
-	DirItem * _constructDirItem( const QString & dirName, DirItem * parentDirItem );
+	Item * _findChildItem( DirItem * dirItem, const QString & name, const PendingItems & pendingItems ) const;
+	void _addChildItem( DirItem * dirItem, Item * item, PendingItems & pendingItems );
+	DirItem * _constructDirItem( const QString & dirName, DirItem * parentDirItem, PendingItems & pendingItems );
 	FileItem * _constructFileItem( const QString & fileName, DirItem * parentDirItem,
 			const QString & sourcePath, const QString & basePath, const QString & format,
-			const QString & relativeDestinationPath, bool & isAdded );
+			const QString & relativeDestinationPath, PendingItems & pendingItems );
 	void _cleanupCachedItems( const QList<Item*> & items, bool emitSignals );
 
 private:
 	QList<QDir> sourceDirs_;
 	DirItem * rootItem_;
-	QList<FileItem*> allFileItems_;
-	QList<FileItem*> allInactiveFileItems_;
-	QList<FileItem*> allUnfinishedFileItems_;
-	QList<FileItem*> allInactiveUnfinishedFileItems_;
-	QList<FileItem*> allActiveFileItems_;
+	FileItemList allFileItems_;
+	FileItemList allInactiveFileItems_;
+	FileItemList allUnfinishedFileItems_;
+	FileItemList allInactiveUnfinishedFileItems_;
+	FileItemList allActiveFileItems_;
 	QHash<int,FileItem*> fileItemForJobId_;
 
 	// file item remove helper
@@ -249,20 +356,38 @@ inline int JobItemModel::Item::weight() const
 
 
 
-inline QList<const JobItemModel::FileItem*> JobItemModel::allFileItems() const
-{ return *reinterpret_cast<const QList<const FileItem*>*>( &allFileItems_ ); }
+inline int JobItemModel::FileItemList::count() const
+{ return count_; }
+
+inline bool JobItemModel::FileItemList::isEmpty() const
+{ return count_ == 0; }
+
+inline bool JobItemModel::FileItemList::contains( const FileItem * const item ) const
+{ return item->isInList[ type_ ]; }
+
+inline JobItemModel::FileItemList::const_iterator JobItemModel::FileItemList::begin() const
+{ return const_iterator( firstItem_, type_ ); }
+
+inline JobItemModel::FileItemList::const_iterator JobItemModel::FileItemList::end() const
+{ return const_iterator( 0, type_ ); }
+
+
+
+
+inline const JobItemModel::FileItemList & JobItemModel::allFileItems() const
+{ return allFileItems_; }
 
-inline QList<const JobItemModel::FileItem*> JobItemModel::allInactiveFileItems() const
-{ return *reinterpret_cast<const QList<const FileItem*>*>( &allInactiveFileItems_ ); }
+inline const JobItemModel::FileItemList & JobItemModel::allInactiveFileItems() const
+{ return allInactiveFileItems_; }
 
-inline QList<const JobItemModel::FileItem*> JobItemModel::allUnfinishedFileItems() const
-{ return *reinterpret_cast<const QList<const FileItem*>*>( &allUnfinishedFileItems_ ); }
+inline const JobItemModel::FileItemList & JobItemModel::allUnfinishedFileItems() const
+{ return allUnfinishedFileItems_; }
 
-inline QList<const JobItemModel::FileItem*> JobItemModel::allInactiveUnfinishedFileItems() const
-{ return *reinterpret_cast<const QList<const FileItem*>*>( &allInactiveUnfinishedFileItems_ ); }
+inline const JobItemModel::FileItemList & JobItemModel::allInactiveUnfinishedFileItems() const
+{ return allInactiveUnfinishedFileItems_; }
 
-inline QList<const JobItemModel::FileItem*> JobItemModel::allActiveFileItems() const
-{ return *reinterpret_cast<const QList<const FileItem*>*>( &allActiveFileItems_ ); }
+inline const JobItemModel::FileItemList & JobItemModel::allActiveFileItems() const
+{ return allActiveFileItems_; }
 
 inline const JobItemModel::FileItem * JobItemModel::aboutToRemoveFileItem() const
 { return aboutToRemoveFileItem_; }
@@ -0,0 +1,251 @@
+
+#include "JobSegment.h"
+
+#include <QMutexLocker>
+#include <QScopedPointer>
+#include <QIODevice>
+
+#include <grim/audio/FormatPlugin.h>
+#include <grim/audio/FormatManager.h>
+
+#include <vorbis/vorbisenc.h>
+
+#include "Deinterleaver.h"
+#include "EncoderSetupCache.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+JobSegment::JobSegment( Job * const job, const qint64 startSample, const qint64 endSample, const bool isLast )
+{
+	setAutoDelete( false );
+
+	job_ = job;
+
+	startSample_ = startSample;
+	endSample_ = endSample;
+	isLast_ = isLast;
+
+	result_ = Converter::JobResult_Null;
+
+	isFinished_ = false;
+	isAborted_ = false;
+	processedSamples_ = 0;
+}
+
+
+void JobSegment::clearPackets()
+{
+	packets_.clear();
+}
+
+
+qint64 JobSegment::processedSamples() const
+{
+	QMutexLocker locker( &mutex_ );
+	return processedSamples_;
+}
+
+
+bool JobSegment::waitForFinished( const unsigned long time )
+{
+	QMutexLocker locker( &mutex_ );
+	if ( !isFinished_ )
+		finishedWaiter_.wait( &mutex_, time );
+	return isFinished_;
+}
+
+
+void JobSegment::restart( const qint64 startSample )
+{
+	Q_ASSERT( isFinished_ );
+
+	startSample_ = startSample;
+
+	result_ = Converter::JobResult_Null;
+	packets_.clear();
+
+	QMutexLocker locker( &mutex_ );
+	isFinished_ = false;
+	processedSamples_ = 0;
+}
+
+
+void JobSegment::abort()
+{
+	QMutexLocker locker( &mutex_ );
+	isAborted_ = true;
+}
+
+
+bool JobSegment::_isAborted() const
+{
+	QMutexLocker locker( &mutex_ );
+	return isAborted_;
+}
+
+
+void JobSegment::run()
+{
+	const Converter::JobResultType result = _isAborted() ? Converter::JobResult_Null : _runBody();
+
+	QMutexLocker locker( &mutex_ );
+	result_ = result;
+	isFinished_ = true;
+	finishedWaiter_.wakeAll();
+}
+
+
+Converter::JobResultType JobSegment::_runBody()
+{
+	const QScopedPointer<Grim::Audio::FormatFile> sourceAudioFile( job_->_createSourceAudioFile() );
+	if ( !sourceAudioFile )
+		return Converter::JobResult_ReadError;
+
+	// source file may be changed since the Job opened it
+	const Grim::Audio::FormatFile * const jobAudioFile = job_->sourceAudioFile_;
+	if ( sourceAudioFile->channels() != jobAudioFile->channels() ||
+			sourceAudioFile->frequency() != jobAudioFile->frequency() ||
+			sourceAudioFile->bitsPerSample() != jobAudioFile->bitsPerSample() )
+		return Converter::JobResult_ReadError;
+
+	if ( !sourceAudioFile->device()->seek( sourceAudioFile->samplesToBytes( startSample_ ) ) )
+		return Converter::JobResult_ReadError;
+
+	// must be the same setup as the Job has, so packets are decodable with the Job headers
+	EncoderSetupCache::Setup * const encoderSetup = EncoderSetupCache::setupForCurrentThread(
+			job_->encoderSettings_, sourceAudioFile->channels(), sourceAudioFile->frequency() );
+	if ( !encoderSetup )
+		return Converter::JobResult_ConvertError;
+
+	vorbis_dsp_state vd;
+	vorbis_analysis_init( &vd, encoderSetup->info() );
+
+	vorbis_block vb;
+	vorbis_block_init( &vd, &vb );
+
+	ogg_packet op;
+
+	static const int kSampleCount = 1024*64;
+
+	const Deinterleaver::Kernel deinterleave = Deinterleaver::kernel(
+			sourceAudioFile->channels(), sourceAudioFile->bitsPerSample() );
+
+	QByteArray sourceBuffer;
+	sourceBuffer.resize( sourceAudioFile->samplesToBytes( kSampleCount ) );
+	const char * const sourceBufferData = sourceBuffer.constData();
+
+	const bool canReadFloat = sourceAudioFile->canReadFloat();
+
+	bool readError = false;
+	bool isAborted = false;
+
+	qint64 remainingSamples = endSample_ - startSample_;
+	int eos = 0;
+
+	while ( !eos )
+	{
+		const qint64 maxSamples = isLast_ ? kSampleCount : qMin<qint64>( remainingSamples, kSampleCount );
+		qint64 sampleCount = 0;
+		if ( maxSamples != 0 )
+		{
+			if ( canReadFloat )
+			{
+				// float decoders write straight into encoder buffers
+				float * channelData[ Deinterleaver::kMaxChannelCount ];
+				job_->_mapChannels( vorbis_analysis_buffer( &vd, int(maxSamples) ), channelData );
+				sampleCount = sourceAudioFile->readFloat( channelData, maxSamples );
+			}
+			else
+			{
+				const qint64 maxBytes = sourceAudioFile->samplesToBytes( maxSamples );
+
+				qint64 bytes;
+				const char * sourceData = sourceAudioFile->readView( maxBytes, bytes );
+				if ( !sourceData && bytes != -1 )
+				{
+					bytes = sourceAudioFile->device()->read( sourceBuffer.data(), maxBytes );
+					sourceData = sourceBufferData;
+				}
+
+				sampleCount = bytes == -1 ? -1 : sourceAudioFile->bytesToSamples( bytes );
+				if ( sampleCount > 0 )
+				{
+					float * channelData[ Deinterleaver::kMaxChannelCount ];
+					job_->_mapChannels( vorbis_analysis_buffer( &vd, int(sampleCount) ), channelData );
+					deinterleave( sourceData, channelData, sampleCount, sourceAudioFile->channels() );
+				}
+			}
+		}
+
+		if ( sampleCount == -1 )
+		{
+			readError = true;
+			break;
+		}
+
+		if ( sampleCount == 0 )
+		{
+			// Only the last segment finishes the stream,
+			// trailing packets of others are replaced with the next segment ones.
+			if ( !isLast_ )
+				break;
+
+			vorbis_analysis_wrote( &vd, 0 );
+		}
+		else
+		{
+			vorbis_analysis_wrote( &vd, int(sampleCount) );
+
+			remainingSamples -= sampleCount;
+
+			QMutexLocker locker( &mutex_ );
+			processedSamples_ += sampleCount;
+			isAborted = isAborted_;
+		}
+
+		if ( isAborted )
+			break;
+
+		while ( vorbis_analysis_blockout( &vd, &vb ) == 1 )
+		{
+			vorbis_analysis( &vb, 0 );
+			vorbis_bitrate_addblock( &vb );
+
+			while ( vorbis_bitrate_flushpacket( &vd, &op ) )
+			{
+				Packet packet;
+				packet.data = QByteArray( reinterpret_cast<const char*>( op.packet ), op.bytes );
+				packet.granulePosition = op.granulepos == -1 ? -1 : startSample_ + op.granulepos;
+				packet.blockSize = vorbis_packet_blocksize( encoderSetup->info(), &op );
+				packet.isEndOfStream = op.e_o_s;
+				packets_ << packet;
+
+				if ( op.e_o_s )
+					eos = 1;
+			}
+		}
+	}
+
+	// cleanup
+	vorbis_block_clear( &vb );
+	vorbis_dsp_clear( &vd );
+
+	if ( isAborted )
+		return Converter::JobResult_Null;
+
+	if ( readError )
+		return Converter::JobResult_ReadError;
+
+	return Converter::JobResult_Done;
+}
+
+
+
+
+} // namespace Fogg
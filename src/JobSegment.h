@@ -0,0 +1,95 @@
+
+#pragma once
+
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+#include <QList>
+
+#include "Converter.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+// Encodes a time range of the Job source file with its own Vorbis encoder.
+// Resulting packets are kept in memory until Job splices them into the output stream.
+class JobSegment : public QRunnable
+{
+public:
+	class Packet
+	{
+	public:
+		QByteArray data;
+		qint64 granulePosition;
+		int blockSize;
+		bool isEndOfStream;
+	};
+
+	JobSegment( Job * job, qint64 startSample, qint64 endSample, bool isLast );
+
+	qint64 startSample() const;
+	qint64 endSample() const;
+	bool isLast() const;
+
+	Converter::JobResultType result() const;
+	const QList<Packet> & packets() const;
+	void clearPackets();
+
+	qint64 processedSamples() const;
+	bool waitForFinished( unsigned long time = ULONG_MAX );
+
+	void restart( qint64 startSample );
+	void abort();
+
+	// reimplemented from QRunnable
+	void run();
+
+private:
+	Converter::JobResultType _runBody();
+	bool _isAborted() const;
+
+private:
+	Job * job_;
+
+	qint64 startSample_;
+	qint64 endSample_;
+	bool isLast_;
+
+	Converter::JobResultType result_;
+	QList<Packet> packets_;
+
+	mutable QMutex mutex_;
+	QWaitCondition finishedWaiter_;
+	bool isFinished_;
+	bool isAborted_;
+	qint64 processedSamples_;
+};
+
+
+
+
+inline qint64 JobSegment::startSample() const
+{ return startSample_; }
+
+inline qint64 JobSegment::endSample() const
+{ return endSample_; }
+
+inline bool JobSegment::isLast() const
+{ return isLast_; }
+
+inline Converter::JobResultType JobSegment::result() const
+{ return result_; }
+
+inline const QList<JobSegment::Packet> & JobSegment::packets() const
+{ return packets_; }
+
+
+
+
+} // namespace Fogg
@@ -13,11 +13,13 @@
 #include <QDirModel>
 #include <QDesktopWidget>
 #include <QMimeData>
+#include <QSet>
 
 #include <grim/audio/FormatManager.h>
 
 #include "Converter.h"
 #include "FileFetcher.h"
+#include "DirWatcher.h"
 #include "FileFetcherDialog.h"
 #include "ProfileNameDialog.h"
 #include "DonationDialog.h"
@@ -276,7 +278,7 @@ int ProfileItemModel::_rowForCustomProfileIndex( const int customProfileIndex )
 
 
 
-MainWindow::MainWindow( Config * const config, Converter * const converter ) :
+MainWindow::MainWindow( Config * const config, Converter * const converter, ScanIndex * const scanIndex ) :
 	config_( config ),
 	converter_( converter )
 {
@@ -337,15 +339,21 @@ MainWindow::MainWindow( Config * const config, Converter * const converter ) :
 	// converter
 	connect( converter_, SIGNAL(jobStarted(int)), SLOT(_jobStarted(int)) );
 	connect( converter_, SIGNAL(jobResolvedFormat(int,QString)), SLOT(_jobResolvedFormat(int,QString)) );
-	connect( converter_, SIGNAL(jobProgress(int,qreal)), SLOT(_jobProgress(int,qreal)) );
+	connect( converter_, SIGNAL(jobsProgress(QVector<QPair<int,qreal> >)), SLOT(_jobsProgress(QVector<QPair<int,qreal> >)) );
 	connect( converter_, SIGNAL(jobFinished(int,int)), SLOT(_jobFinished(int,int)) );
 
 	fileFetcher_ = new FileFetcher( this );
 	fileFetcher_->setFilters( _collectMediaFileFilters() );
+	fileFetcher_->setScanIndex( scanIndex );
 	connect( fileFetcher_, SIGNAL(currentDirChanged(QString)), SLOT(_currentFetchDirChanged(QString)) );
-	connect( fileFetcher_, SIGNAL(fetched(QString,QString,bool)), SLOT(_fetched(QString,QString,bool)) );
+	connect( fileFetcher_, SIGNAL(fetched(QStringList,QString,bool)), SLOT(_fetched(QStringList,QString,bool)) );
 	connect( fileFetcher_, SIGNAL(finished()), SLOT(_fetchFinished()) );
 
+	// dir watcher
+	dirWatcher_ = new DirWatcher( this );
+	dirWatcher_->setFilters( _collectMediaFileFilters() );
+	connect( dirWatcher_, SIGNAL(fileSettled(QString,QString)), SLOT(_watchedFileSettled(QString,QString)) );
+
 	// user interface
 	ui_.setupUi( this );
 
@@ -427,6 +435,7 @@ MainWindow::MainWindow( Config * const config, Converter * const converter ) :
 	connect( jobItemModel_, SIGNAL(itemProgressChanged()), SLOT(_jobItemProgressChanged()) );
 
 	_setJobItemModelSourcePaths();
+	_updateDirWatcherPaths();
 
 	ui_.jobView->header()->restoreState( config_->jobViewHeaderState() );
 	ui_.jobView->setSelectionMode( QAbstractItemView::ExtendedSelection );
@@ -613,7 +622,9 @@ void MainWindow::_updateCurrentProfile()
 
 	const Config::Profile currentProfile = this->currentProfile();
 	ui_.profilePathLineEdit->setText( currentProfile.path );
-	ui_.profileQualityWidget->setValue( currentProfile.quality );
+	ui_.profileQualityWidget->setValue( currentProfile.encoderSettings.quality );
+	// bitrates of managed modes are edited in configuration file or by fogg-cli options only
+	ui_.profileQualityWidget->setEnabled( !currentProfile.encoderSettings.isManaged() );
 	ui_.profilePrependYearToAlbumCheckBox->setChecked( currentProfile.prependYearToAlbum );
 
 	ui_.actionRemoveProfile->setEnabled( isCustomProfile );
@@ -630,6 +641,18 @@ void MainWindow::_setJobItemModelSourcePaths()
 }
 
 
+void MainWindow::_updateDirWatcherPaths()
+{
+	QStringList paths;
+	if ( config_->watchSourceDirs() )
+	{
+		foreach ( const Config::SourceDir & sourceDir, config_->sourceDirs() )
+			paths << sourceDir.path;
+	}
+	dirWatcher_->setPaths( paths );
+}
+
+
 void MainWindow::_startFileFetch( const QList<QUrl> & urls )
 {
 	Q_ASSERT( !fileFetcher_->isRunning() );
@@ -661,10 +684,7 @@ void MainWindow::_finishFileFetch()
 			filePaths << fetchFileInfo.filePath;
 
 		if ( nonRecognizedFilesDialog_->exec( filePaths ) == QDialog::Accepted )
-		{
-			foreach ( const FetchedFileInfo & fetchFileInfo, nonRecognizedFetchedFileInfos_ )
-				_tryAddFile( fetchFileInfo.filePath, fetchFileInfo.basePath, QString() );
-		}
+			_addFiles( nonRecognizedFetchedFileInfos_ );
 	}
 
 	if ( !failedFetchedFilePaths_.isEmpty() )
@@ -684,22 +704,34 @@ void MainWindow::_finishFileFetch()
 }
 
 
-bool MainWindow::_tryAddFile( const QString & filePath, const QString & basePath, const QString & format )
+void MainWindow::_addFiles( const QList<FetchedFileInfo> & fetchedFileInfos )
 {
-	bool isAdded;
-	const QModelIndex index = jobItemModel_->addFile( filePath, basePath, format, isAdded );
+	QVector<JobItemModel::FetchedFile> files;
+	files.reserve( fetchedFileInfos.count() );
+	foreach ( const FetchedFileInfo & fetchedFileInfo, fetchedFileInfos )
+		files << JobItemModel::FetchedFile( fetchedFileInfo.filePath, fetchedFileInfo.basePath, fetchedFileInfo.format );
 
-	if ( !index.isValid() )
+	const QVector<QModelIndex> indexes = jobItemModel_->addFiles( files );
+
+	// expand index branches to make them visible, each branch only once
+	QSet<QModelIndex> expandedIndexes;
+	for ( int i = 0; i < indexes.count(); ++i )
 	{
-		failedFetchedFilePaths_ << filePath;
-		return false;
-	}
+		const QModelIndex & index = indexes.at( i );
 
-	// expand index branch to make it visible
-	for ( QModelIndex parentIndex = index.parent(); parentIndex.isValid(); parentIndex = parentIndex.parent() )
-		ui_.jobView->expand( parentIndex );
+		if ( !index.isValid() )
+		{
+			failedFetchedFilePaths_ << files.at( i ).filePath;
+			continue;
+		}
 
-	return true;
+		for ( QModelIndex parentIndex = index.parent(); parentIndex.isValid() && !expandedIndexes.contains( parentIndex );
+				parentIndex = parentIndex.parent() )
+		{
+			expandedIndexes << parentIndex;
+			ui_.jobView->expand( parentIndex );
+		}
+	}
 }
 
 
@@ -835,11 +867,9 @@ void MainWindow::_jobResolvedFormat( const int jobId, const QString & format )
 }
 
 
-void MainWindow::_jobProgress( const int jobId, const qreal progress )
+void MainWindow::_jobsProgress( const QVector<QPair<int,qreal> > & progress )
 {
-	const JobItemModel::FileItem * const fileItem = jobItemModel_->fileItemForJobId( jobId );
-	const QModelIndex index = jobItemModel_->indexForItem( fileItem );
-	jobItemModel_->setFileItemProgressForIndex( index, progress );
+	jobItemModel_->setJobsProgress( progress );
 }
 
 
@@ -856,23 +886,73 @@ void MainWindow::_currentFetchDirChanged( const QString & dirPath )
 }
 
 
-void MainWindow::_fetched( const QString & filePath, const QString & basePath, const bool extensionRecognized )
+void MainWindow::_fetched( const QStringList & filePaths, const QString & basePath, const bool extensionRecognized )
 {
-	fetchedFileCount_++;
+	fetchedFileCount_ += filePaths.count();
 	fileFetcherDialog_->setFileCount( fetchedFileCount_ );
 
 	if ( !extensionRecognized )
 	{
-		nonRecognizedFetchedFileInfos_ << FetchedFileInfo( filePath, basePath );
+		foreach ( const QString & filePath, filePaths )
+			nonRecognizedFetchedFileInfos_ << FetchedFileInfo( filePath, basePath );
 		return;
 	}
 
+	QList<FetchedFileInfo> fetchedFileInfos;
+	foreach ( const QString & filePath, filePaths )
+	{
+		const QString extension = QFileInfo( filePath ).suffix();
+		const QStringList formats = converter_->audioFormatManager()->formatsForExtension( extension );
+		Q_ASSERT( !formats.isEmpty() );
+
+		fetchedFileInfos << FetchedFileInfo( filePath, basePath, formats.first() );
+	}
+
+	_addFiles( fetchedFileInfos );
+}
+
+
+void MainWindow::_watchedFileSettled( const QString & filePath, const QString & basePath )
+{
+	const Config::Profile currentProfile = this->currentProfile();
+
+	// destination dir might be inside of a watched dir, converted files would be converted onto themselves forever
+	const QString destinationDirPath = QDir( currentProfile.path ).absolutePath() + QLatin1Char( '/' );
+	if ( QFileInfo( filePath ).absoluteFilePath().startsWith( destinationDirPath ) )
+		return;
+
 	const QString extension = QFileInfo( filePath ).suffix();
 	const QStringList formats = converter_->audioFormatManager()->formatsForExtension( extension );
-	Q_ASSERT( !formats.isEmpty() );
+	if ( formats.isEmpty() )
+		return;
 
-	if ( !_tryAddFile( filePath, basePath, formats.first() ) )
+	const QModelIndex index = jobItemModel_->addFiles( QVector<JobItemModel::FetchedFile>()
+			<< JobItemModel::FetchedFile( filePath, basePath, formats.first() ) ).first();
+	if ( !index.isValid() )
+	{
+		foggWarning() << "Watched file clashes with another job, skipping:" << filePath;
 		return;
+	}
+
+	for ( QModelIndex parentIndex = index.parent(); parentIndex.isValid(); parentIndex = parentIndex.parent() )
+		ui_.jobView->expand( parentIndex );
+
+	const JobItemModel::FileItem * const fileItem = jobItemModel_->itemForIndex( index )->asFile();
+
+	// file was written again, start its conversion over
+	if ( fileItem->jobId != 0 )
+	{
+		converter_->abortJob( fileItem->jobId );
+		jobItemModel_->setFileItemJobIdForIndex( index, 0 );
+	}
+	jobItemModel_->setFileItemUnmarkedForIndex( index );
+
+	const int jobId = converter_->addJob( fileItem->sourcePath, fileItem->format,
+			QDir( currentProfile.path ).absoluteFilePath( fileItem->relativeDestinationPath ),
+			currentProfile.encoderSettings, currentProfile.sampleRate, currentProfile.prependYearToAlbum, true );
+	jobItemModel_->setFileItemJobIdForIndex( index, jobId );
+
+	_updateJobActions();
 }
 
 
@@ -976,7 +1056,7 @@ void MainWindow::on_profilePrependYearToAlbumCheckBox_toggled()
 void MainWindow::on_profileQualityWidget_valueChanged()
 {
 	Config::Profile currentProfile = this->currentProfile();
-	currentProfile.quality = ui_.profileQualityWidget->value();
+	currentProfile.encoderSettings.quality = ui_.profileQualityWidget->value();
 	setCurrentProfile( currentProfile );
 }
 
@@ -1053,8 +1133,10 @@ void MainWindow::on_actionRemoveAll_triggered()
 
 void MainWindow::on_actionUnmark_triggered()
 {
-	foreach ( const JobItemModel::FileItem * const fileItem, jobItemModel_->allFileItems() )
+	const JobItemModel::FileItemList & fileItems = jobItemModel_->allFileItems();
+	for ( JobItemModel::FileItemList::const_iterator it = fileItems.begin(); it != fileItems.end(); ++it )
 	{
+		const JobItemModel::FileItem * const fileItem = *it;
 		if ( fileItem->jobId != 0 )
 			continue;
 
@@ -1131,7 +1213,7 @@ void MainWindow::on_actionStartConversion_triggered()
 
 	const QDir profileDir = QDir( currentProfile.path );
 
-	foreach ( const JobItemModel::FileItem * const fileItem, jobItemModel_->allInactiveFileItems() )
+	foreach ( const JobItemModel::FileItem * const fileItem, jobItemModel_->allInactiveFileItems().toList() )
 	{
 		if ( fileItem->result != Converter::JobResult_Null )
 		{
@@ -1141,7 +1223,7 @@ void MainWindow::on_actionStartConversion_triggered()
 
 		const int jobId = converter_->addJob( fileItem->sourcePath, fileItem->format,
 				profileDir.absoluteFilePath( fileItem->relativeDestinationPath ),
-				currentProfile.quality, currentProfile.prependYearToAlbum );
+				currentProfile.encoderSettings, currentProfile.sampleRate, currentProfile.prependYearToAlbum, false );
 
 		const QModelIndex index = jobItemModel_->indexForItem( fileItem );
 		jobItemModel_->setFileItemJobIdForIndex( index, jobId );
@@ -1155,7 +1237,7 @@ void MainWindow::on_actionStopConversion_triggered()
 {
 	converter_->abortAllJobs();
 
-	foreach ( const JobItemModel::FileItem * const fileItem, jobItemModel_->allActiveFileItems() )
+	foreach ( const JobItemModel::FileItem * const fileItem, jobItemModel_->allActiveFileItems().toList() )
 	{
 		const QModelIndex index = jobItemModel_->indexForItem( fileItem );
 		jobItemModel_->setFileItemJobIdForIndex( index, 0 );
@@ -1192,9 +1274,12 @@ void MainWindow::on_actionPreferences_triggered()
 	preferencesDialog_->exec();
 
 	converter_->setConcurrentThreadCount( config_->concurrentThreadCount() );
+	converter_->setSplitLongFiles( config_->splitLongFiles() );
 
 	if ( preferencesDialog_->hasSourcePathChanged() )
 		_setJobItemModelSourcePaths();
+
+	_updateDirWatcherPaths();
 }
 
 
@@ -4,6 +4,8 @@
 #include <QMainWindow>
 #include <QAbstractItemModel>
 #include <QPointer>
+#include <QVector>
+#include <QPair>
 
 #include <grim/tools/LocalizationManager.h>
 
@@ -34,6 +36,7 @@ namespace Fogg {
 class Config;
 class Converter;
 class FileFetcher;
+class DirWatcher;
 class FileFetcherDialog;
 class ProfileNameDialog;
 class DonationDialog;
@@ -42,6 +45,7 @@ class PreferencesDialog;
 class SkippedFilesDialog;
 class NonRecognizedFilesDialog;
 class JobItemModel;
+class ScanIndex;
 
 
 
@@ -104,7 +108,7 @@ class MainWindow : public QMainWindow
 	Q_OBJECT
 
 public:
-	MainWindow( Config * config, Converter * converter );
+	MainWindow( Config * config, Converter * converter, ScanIndex * scanIndex );
 	~MainWindow();
 
 	void abort();
@@ -127,12 +131,13 @@ private:
 	class FetchedFileInfo
 	{
 	public:
-		FetchedFileInfo( const QString & _filePath, const QString & _basePath ) :
-			filePath( _filePath ), basePath( _basePath )
+		FetchedFileInfo( const QString & _filePath, const QString & _basePath, const QString & _format = QString() ) :
+			filePath( _filePath ), basePath( _basePath ), format( _format )
 		{}
 
 		QString filePath;
 		QString basePath;
+		QString format;
 	};
 
 private:
@@ -147,9 +152,10 @@ private:
 	void _updateFileFetcherActions();
 	void _updateCurrentProfile();
 	void _setJobItemModelSourcePaths();
+	void _updateDirWatcherPaths();
 	void _startFileFetch( const QList<QUrl> & urls );
 	void _finishFileFetch();
-	bool _tryAddFile( const QString & filePath, const QString & basePath, const QString & format );
+	void _addFiles( const QList<FetchedFileInfo> & fetchedFileInfos );
 
 private slots:
 	void _aboutToQuit();
@@ -158,13 +164,15 @@ private slots:
 
 	void _jobStarted( int jobId );
 	void _jobResolvedFormat( int jobId, const QString & format );
-	void _jobProgress( int jobId, qreal progress );
+	void _jobsProgress( const QVector<QPair<int,qreal> > & progress );
 	void _jobFinished( int jobId, int result );
 
 	void _currentFetchDirChanged( const QString & dirPath );
-	void _fetched( const QString & filePath, const QString & basePath, bool extensionRecognized );
+	void _fetched( const QStringList & filePaths, const QString & basePath, bool extensionRecognized );
 	void _fetchFinished();
 
+	void _watchedFileSettled( const QString & filePath, const QString & basePath );
+
 	void _showFileFetcherDialog();
 	void _fileFetchDialogAborted();
 
@@ -223,6 +231,9 @@ private:
 	QPointer<FileFetcherDialog> fileFetcherDialog_;
 	QPointer<QTimer> fileFetcherDialogAppearTimer_;
 
+	// dir watcher
+	QPointer<DirWatcher> dirWatcher_;
+
 	// dialogs
 	QPointer<ProfileNameDialog> profileNameDialog_;
 	QPointer<DonationDialog> donationDialog_;
@@ -0,0 +1,81 @@
+
+#include "OggPageWriter.h"
+
+#include <QIODevice>
+
+#include <string.h>
+
+
+
+
+namespace Fogg {
+
+
+
+
+// Ogg page is at most 64KB, few minutes of audio fit into a single flush
+static const int kBufferSize = 1024*1024;
+
+
+
+
+OggPageWriter::OggPageWriter()
+{
+	device_ = 0;
+	size_ = 0;
+}
+
+
+void OggPageWriter::setDevice( QIODevice * const device )
+{
+	Q_ASSERT( size_ == 0 );
+
+	device_ = device;
+}
+
+
+bool OggPageWriter::write( const ogg_page & page )
+{
+	const int pageSize = int(page.header_len + page.body_len);
+	Q_ASSERT( pageSize <= kBufferSize );
+
+	if ( size_ + pageSize > kBufferSize && !flush() )
+		return false;
+
+	// allocated on first page, jobs waiting in queue do not hold the buffer
+	if ( buffer_.isEmpty() )
+		buffer_.resize( kBufferSize );
+
+	char * const data = buffer_.data() + size_;
+	memcpy( data, page.header, page.header_len );
+	memcpy( data + page.header_len, page.body, page.body_len );
+	size_ += pageSize;
+
+	return true;
+}
+
+
+bool OggPageWriter::flush()
+{
+	Q_ASSERT( device_ );
+
+	if ( size_ == 0 )
+		return true;
+
+	const qint64 bytesWritten = device_->write( buffer_.constData(), size_ );
+	const bool isWritten = bytesWritten == size_;
+	size_ = 0;
+
+	return isWritten;
+}
+
+
+void OggPageWriter::discard()
+{
+	size_ = 0;
+}
+
+
+
+
+} // namespace Fogg
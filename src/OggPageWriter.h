@@ -0,0 +1,53 @@
+
+#pragma once
+
+#include <QByteArray>
+
+#include <ogg/ogg.h>
+
+
+
+
+class QIODevice;
+
+
+
+
+namespace Fogg {
+
+
+
+
+// Gathers Ogg pages into a large buffer, so output is written in a few big chunks
+// instead of two small writes per page, which are slow on network file systems and USB drives.
+class OggPageWriter
+{
+public:
+	OggPageWriter();
+
+	QIODevice * device() const;
+	void setDevice( QIODevice * device );
+
+	// both return false on write error, buffered pages are lost then
+	bool write( const ogg_page & page );
+	bool flush();
+
+	// drops buffered pages, used when output is started over
+	void discard();
+
+private:
+	QIODevice * device_;
+	QByteArray buffer_;
+	int size_;
+};
+
+
+
+
+inline QIODevice * OggPageWriter::device() const
+{ return device_; }
+
+
+
+
+} // namespace Fogg
@@ -9,6 +9,7 @@
 #include <grim/tools/LocalizationManager.h>
 
 #include "Config.h"
+#include "DirWatcher.h"
 
 
 
@@ -107,6 +108,9 @@ PreferencesDialog::PreferencesDialog( Config * const config, Grim::Tools::Locali
 	ui_.concurrentThreadCountSpinBox->setMinimum( 0 );
 	ui_.concurrentThreadCountSpinBox->setMaximum( config_->maximumConcurrentThreadCount() );
 
+	// split long files
+	ui_.splitLongFilesCheckBox->setChecked( config_->splitLongFiles() );
+
 	// default quality
 	ui_.defaultEncodingQualityWidget->setValue( config_->defaultQuality() );
 
@@ -121,6 +125,10 @@ PreferencesDialog::PreferencesDialog( Config * const config, Grim::Tools::Locali
 
 	_sourcePathViewSelectionChanged();
 
+	// watch source paths
+	ui_.watchSourceDirsCheckBox->setEnabled( DirWatcher::isSupported() );
+	ui_.watchSourceDirsCheckBox->setChecked( config_->watchSourceDirs() );
+
 	_retranslateUi();
 }
 
@@ -186,6 +194,18 @@ void PreferencesDialog::on_concurrentThreadCountSpinBox_valueChanged()
 }
 
 
+void PreferencesDialog::on_splitLongFilesCheckBox_toggled()
+{
+	config_->setSplitLongFiles( ui_.splitLongFilesCheckBox->isChecked() );
+}
+
+
+void PreferencesDialog::on_watchSourceDirsCheckBox_toggled()
+{
+	config_->setWatchSourceDirs( ui_.watchSourceDirsCheckBox->isChecked() );
+}
+
+
 void PreferencesDialog::on_defaultEncodingQualityWidget_valueChanged()
 {
 	config_->setDefaultQuality( ui_.defaultEncodingQualityWidget->value() );
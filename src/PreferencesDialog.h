@@ -73,6 +73,8 @@ private:
 private slots:
 	void on_languageComboBox_activated( int index );
 	void on_concurrentThreadCountSpinBox_valueChanged();
+	void on_splitLongFilesCheckBox_toggled();
+	void on_watchSourceDirsCheckBox_toggled();
 	void on_defaultEncodingQualityWidget_valueChanged();
 	void on_addSourcePathButton_clicked();
 	void on_removeSourcePathButton_clicked();
@@ -0,0 +1,340 @@
+#include "Resampler.h"
+
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <cmath>
+#include <cstring>
+
+#include "Deinterleaver.h"
+
+#if defined(Q_PROCESSOR_X86) && defined(Q_CC_GNU)
+#	define FOGG_RESAMPLER_X86
+#	include <immintrin.h>
+#	define FOGG_TARGET_SSE2 __attribute__((target("sse2")))
+#	define FOGG_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+
+
+namespace Fogg {
+
+
+
+
+static const double kPi = 3.14159265358979323846;
+
+// Kaiser window design: passband ends at 90% of the lower Nyquist frequency,
+// stopband starts at the lower Nyquist frequency, so nothing aliases back into the audible range
+static const double kPassbandEdge = 0.90;
+static const double kStopbandAttenuation = 96.0;
+
+// ratios of odd rates would need a phase per output sample, such filters get quantized phases instead
+static const int kMaximumPhaseCount = 1024;
+
+// filter length is a multiple of vector width
+static const int kTapAlignment = 8;
+
+static QMutex filterBankMutex;
+static QHash<QPair<int,int>,QVector<float> > filterBankForRatio;
+
+
+
+
+static int _greatestCommonDivisor( int a, int b )
+{
+	while ( b != 0 )
+	{
+		const int remainder = a % b;
+		a = b;
+		b = remainder;
+	}
+	return a;
+}
+
+
+static double _besselI0( const double x )
+{
+	double sum = 1;
+	double term = 1;
+	for ( int k = 1; term > sum*1e-12; ++k )
+	{
+		const double factor = x / (2*k);
+		term *= factor*factor;
+		sum += term;
+	}
+	return sum;
+}
+
+
+static double _sinc( const double x )
+{
+	if ( x == 0 )
+		return 1;
+	return std::sin( kPi*x ) / (kPi*x);
+}
+
+
+// Reference implementation, vectorized kernels differ in summation order only.
+static float _dotScalar( const float * const samples, const float * const taps, const int tapCount )
+{
+	float sum = 0;
+	for ( int i = 0; i < tapCount; ++i )
+		sum += samples[ i ]*taps[ i ];
+	return sum;
+}
+
+
+#ifdef FOGG_RESAMPLER_X86
+
+FOGG_TARGET_SSE2
+static float _dotSse2( const float * const samples, const float * const taps, const int tapCount )
+{
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	for ( int i = 0; i < tapCount; i += 8 )
+	{
+		sum0 = _mm_add_ps( sum0, _mm_mul_ps( _mm_loadu_ps( samples + i ), _mm_loadu_ps( taps + i ) ) );
+		sum1 = _mm_add_ps( sum1, _mm_mul_ps( _mm_loadu_ps( samples + i + 4 ), _mm_loadu_ps( taps + i + 4 ) ) );
+	}
+
+	__m128 sum = _mm_add_ps( sum0, sum1 );
+	sum = _mm_add_ps( sum, _mm_movehl_ps( sum, sum ) );
+	sum = _mm_add_ss( sum, _mm_shuffle_ps( sum, sum, 1 ) );
+	return _mm_cvtss_f32( sum );
+}
+
+
+FOGG_TARGET_AVX2
+static float _dotAvx2( const float * const samples, const float * const taps, const int tapCount )
+{
+	__m256 sum = _mm256_setzero_ps();
+
+	for ( int i = 0; i < tapCount; i += 8 )
+		sum = _mm256_add_ps( sum, _mm256_mul_ps( _mm256_loadu_ps( samples + i ), _mm256_loadu_ps( taps + i ) ) );
+
+	__m128 half = _mm_add_ps( _mm256_castps256_ps128( sum ), _mm256_extractf128_ps( sum, 1 ) );
+	half = _mm_add_ps( half, _mm_movehl_ps( half, half ) );
+	half = _mm_add_ss( half, _mm_shuffle_ps( half, half, 1 ) );
+	return _mm_cvtss_f32( half );
+}
+
+#endif // FOGG_RESAMPLER_X86
+
+
+
+
+Resampler::Resampler( const int channelCount, const int sourceRate, const int targetRate )
+{
+	Q_ASSERT( channelCount > 0 );
+	Q_ASSERT( sourceRate > 0 && targetRate > 0 );
+
+	channelCount_ = channelCount;
+	sourceRate_ = sourceRate;
+	targetRate_ = targetRate;
+
+	const int divisor = _greatestCommonDivisor( sourceRate_, targetRate_ );
+	upFactor_ = targetRate_ / divisor;
+	downFactor_ = sourceRate_ / divisor;
+	phaseCount_ = qMin( upFactor_, kMaximumPhaseCount );
+
+	// Kaiser estimate of filter length for the transition band width in cycles per source sample
+	const double cutoffRatio = qMin( 1.0, double(upFactor_) / downFactor_ );
+	const double transitionWidth = 0.5*cutoffRatio*(1 - kPassbandEdge);
+	const int tapCount = int(std::ceil( (kStopbandAttenuation - 7.95) / (2.285*2*kPi*transitionWidth) )) + 1;
+	tapCount_ = (tapCount + kTapAlignment - 1) / kTapAlignment * kTapAlignment;
+
+	filterBank_ = _filterBank( upFactor_, downFactor_, phaseCount_, tapCount_ );
+	dot_ = _dotKernel();
+
+	// silence before the first source sample
+	const int halfTapCount = tapCount_/2;
+	buffers_.resize( channelCount_ );
+	for ( int channelIndex = 0; channelIndex < channelCount_; ++channelIndex )
+		buffers_[ channelIndex ].fill( 0.0f, halfTapCount - 1 );
+
+	bufferStart_ = -(halfTapCount - 1);
+	sourceSampleCount_ = 0;
+	outputIndex_ = 0;
+	isFlushed_ = false;
+}
+
+
+// Phase p holds taps for output positioned p/phaseCount of a source sample after the center tap.
+// One extra phase for position 1.0 saves wrapping to the next source sample on quantized phases.
+QVector<float> Resampler::_filterBank( const int upFactor, const int downFactor, const int phaseCount, const int tapCount )
+{
+	const QPair<int,int> ratio( upFactor, downFactor );
+
+	QMutexLocker locker( &filterBankMutex );
+
+	const QHash<QPair<int,int>,QVector<float> >::const_iterator it = filterBankForRatio.constFind( ratio );
+	if ( it != filterBankForRatio.constEnd() )
+		return it.value();
+
+	const double cutoffRatio = qMin( 1.0, double(upFactor) / downFactor );
+	const double cutoff = 0.5*cutoffRatio*(1 + kPassbandEdge)/2;
+	const double beta = 0.1102*(kStopbandAttenuation - 8.7);
+	const double halfWidth = tapCount/2;
+	const double windowScale = 1 / _besselI0( beta );
+
+	QVector<float> filterBank( (phaseCount + 1)*tapCount );
+	QVector<double> taps( tapCount );
+
+	for ( int phase = 0; phase <= phaseCount; ++phase )
+	{
+		const double offset = double(phase) / phaseCount;
+
+		double sum = 0;
+		for ( int tapIndex = 0; tapIndex < tapCount; ++tapIndex )
+		{
+			const double time = tapIndex - (halfWidth - 1) - offset;
+			const double windowPosition = qMin( 1.0, qAbs( time ) / halfWidth );
+			const double window = _besselI0( beta*std::sqrt( 1 - windowPosition*windowPosition ) ) * windowScale;
+			taps[ tapIndex ] = 2*cutoff*_sinc( 2*cutoff*time )*window;
+			sum += taps[ tapIndex ];
+		}
+
+		// unity gain at DC for every phase
+		float * const phaseTaps = filterBank.data() + phase*tapCount;
+		for ( int tapIndex = 0; tapIndex < tapCount; ++tapIndex )
+			phaseTaps[ tapIndex ] = float(taps[ tapIndex ] / sum);
+	}
+
+	filterBankForRatio[ ratio ] = filterBank;
+	return filterBank;
+}
+
+
+Resampler::DotKernel Resampler::_dotKernel()
+{
+#ifdef FOGG_RESAMPLER_X86
+	switch ( Deinterleaver::bestInstructionSet() )
+	{
+	case Deinterleaver::InstructionSet_Avx2:
+		return _dotAvx2;
+	case Deinterleaver::InstructionSet_Sse2:
+		return _dotSse2;
+	case Deinterleaver::InstructionSet_Scalar:
+		break;
+	}
+#endif
+
+	return _dotScalar;
+}
+
+
+// Output samples up to the returned index are computable from sourceSampleCount source samples.
+static qint64 _availableOutputEnd( const qint64 sourceSampleCount, const int halfTapCount,
+		const int upFactor, const int downFactor )
+{
+	const qint64 lastCenter = sourceSampleCount - halfTapCount;
+	if ( lastCenter <= 0 )
+		return 0;
+	return (lastCenter*upFactor - 1)/downFactor + 1;
+}
+
+
+int Resampler::outputSampleCount( const int sampleCount ) const
+{
+	const qint64 end = _availableOutputEnd( sourceSampleCount_ + sampleCount, tapCount_/2, upFactor_, downFactor_ );
+	return int(qMax<qint64>( 0, end - outputIndex_ ));
+}
+
+
+int Resampler::process( const float * const * const input, const int sampleCount, float * const * const output )
+{
+	Q_ASSERT( !isFlushed_ );
+
+	_append( input, sampleCount );
+	sourceSampleCount_ += sampleCount;
+
+	return _resample( _availableOutputEnd( sourceSampleCount_, tapCount_/2, upFactor_, downFactor_ ), output );
+}
+
+
+int Resampler::tailSampleCount() const
+{
+	if ( isFlushed_ )
+		return 0;
+
+	const qint64 totalOutputCount = (sourceSampleCount_*upFactor_ + downFactor_ - 1)/downFactor_;
+	return int(totalOutputCount - outputIndex_);
+}
+
+
+int Resampler::flush( float * const * const output )
+{
+	Q_ASSERT( !isFlushed_ );
+
+	const qint64 totalOutputCount = (sourceSampleCount_*upFactor_ + downFactor_ - 1)/downFactor_;
+
+	// silence after the last source sample
+	const int halfTapCount = tapCount_/2;
+	for ( int channelIndex = 0; channelIndex < channelCount_; ++channelIndex )
+	{
+		QVector<float> & buffer = buffers_[ channelIndex ];
+		const int size = buffer.size();
+		buffer.resize( size + halfTapCount );
+		memset( buffer.data() + size, 0, halfTapCount*sizeof(float) );
+	}
+
+	const int count = _resample( totalOutputCount, output );
+	isFlushed_ = true;
+	return count;
+}
+
+
+void Resampler::_append( const float * const * const input, const int sampleCount )
+{
+	for ( int channelIndex = 0; channelIndex < channelCount_; ++channelIndex )
+	{
+		QVector<float> & buffer = buffers_[ channelIndex ];
+		const int size = buffer.size();
+		buffer.resize( size + sampleCount );
+		memcpy( buffer.data() + size, input[ channelIndex ], sampleCount*sizeof(float) );
+	}
+}
+
+
+int Resampler::_resample( const qint64 endOutputIndex, float * const * const output )
+{
+	const int halfTapCount = tapCount_/2;
+
+	int count = 0;
+	for ( ; outputIndex_ < endOutputIndex; ++outputIndex_, ++count )
+	{
+		const qint64 position = outputIndex_*downFactor_;
+		const qint64 centerIndex = position / upFactor_;
+		const qint64 remainder = position % upFactor_;
+		const int phase = phaseCount_ == upFactor_ ? int(remainder) :
+				int((remainder*phaseCount_ + upFactor_/2) / upFactor_);
+
+		const float * const taps = filterBank_.constData() + phase*tapCount_;
+		const int offset = int(centerIndex - (halfTapCount - 1) - bufferStart_);
+
+		for ( int channelIndex = 0; channelIndex < channelCount_; ++channelIndex )
+			output[ channelIndex ][ count ] = dot_( buffers_.at( channelIndex ).constData() + offset, taps, tapCount_ );
+	}
+
+	// drop source samples no further output reaches
+	const qint64 nextFirstIndex = (outputIndex_*downFactor_) / upFactor_ - (halfTapCount - 1);
+	const int dropCount = int(qBound<qint64>( 0, nextFirstIndex - bufferStart_, buffers_.first().size() ));
+	if ( dropCount > 0 )
+	{
+		for ( int channelIndex = 0; channelIndex < channelCount_; ++channelIndex )
+			buffers_[ channelIndex ].remove( 0, dropCount );
+		bufferStart_ += dropCount;
+	}
+
+	return count;
+}
+
+
+
+
+} // namespace Fogg
@@ -0,0 +1,85 @@
+
+#pragma once
+
+#include <QVector>
+
+
+
+
+namespace Fogg {
+
+
+
+
+// Converts planar float samples between sample rates with a polyphase windowed sinc filter.
+// Rates ratio is reduced to L/M, filter bank has a phase for each of L output positions
+// between two source samples and is built once per ratio, shared by all resamplers.
+// Output stays aligned with source: first output sample is taken at the time of the first source sample,
+// and flush() completes the stream to ceil( sourceSamples*L/M ) samples.
+class Resampler
+{
+public:
+	Resampler( int channelCount, int sourceRate, int targetRate );
+
+	int channelCount() const;
+	int sourceRate() const;
+	int targetRate() const;
+
+	// exact number of samples the next process() call returns for the given source sample count
+	int outputSampleCount( int sampleCount ) const;
+
+	// consumes all source samples, returns number of samples written to output
+	int process( const float * const * input, int sampleCount, float * const * output );
+
+	// exact number of samples flush() returns
+	int tailSampleCount() const;
+
+	// writes samples left in filter after the end of source
+	int flush( float * const * output );
+
+private:
+	typedef float (*DotKernel)( const float * samples, const float * taps, int tapCount );
+
+	static QVector<float> _filterBank( int upFactor, int downFactor, int phaseCount, int tapCount );
+	static DotKernel _dotKernel();
+
+	void _append( const float * const * input, int sampleCount );
+	int _resample( qint64 endOutputIndex, float * const * output );
+
+private:
+	int channelCount_;
+	int sourceRate_;
+	int targetRate_;
+
+	int upFactor_;
+	int downFactor_;
+	int phaseCount_;
+	int tapCount_;
+	QVector<float> filterBank_;
+	DotKernel dot_;
+
+	// per channel source samples, bufferStart_ is the absolute source index of the first one,
+	// buffers are primed with silence so filter is centered at the first source sample
+	QVector<QVector<float> > buffers_;
+	qint64 bufferStart_;
+	qint64 sourceSampleCount_;
+	qint64 outputIndex_;
+	bool isFlushed_;
+};
+
+
+
+
+inline int Resampler::channelCount() const
+{ return channelCount_; }
+
+inline int Resampler::sourceRate() const
+{ return sourceRate_; }
+
+inline int Resampler::targetRate() const
+{ return targetRate_; }
+
+
+
+
+} // namespace Fogg
@@ -0,0 +1,197 @@
+
+#include "ScanIndex.h"
+
+#include <QMutexLocker>
+#include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDataStream>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QSet>
+
+#include "Global.h"
+
+
+
+
+namespace Fogg {
+
+
+
+
+static const QString kScanIndexFileName = QLatin1String( "scan-index" );
+
+static const quint32 kScanIndexMagic = 0x666f7369; // "fosi"
+static const quint32 kScanIndexVersion = 1;
+
+// directory modified that recently may still change within the same timestamp, do not trust it
+static const qint64 kRacyModificationInterval = 2*1000;
+
+
+
+
+ScanIndex::ScanIndex()
+{
+	isChanged_ = false;
+}
+
+
+QString ScanIndex::_filePath()
+{
+	// same place as conversion manifest
+	return QDir( QStandardPaths::writableLocation( QStandardPaths::DataLocation ) ).absoluteFilePath( kScanIndexFileName );
+}
+
+
+void ScanIndex::load()
+{
+	QMutexLocker locker( &mutex_ );
+
+	entryForDirPath_.clear();
+	isChanged_ = false;
+
+	QFile file( _filePath() );
+	if ( !file.open( QIODevice::ReadOnly ) )
+		return;
+
+	QDataStream stream( &file );
+
+	quint32 magic;
+	quint32 version;
+	stream >> magic >> version;
+	if ( magic != kScanIndexMagic || version != kScanIndexVersion )
+	{
+		foggWarning() << "Scan index has unknown format, ignoring:" << file.fileName();
+		return;
+	}
+
+	qint32 count;
+	stream >> count;
+
+	for ( int i = 0; i < count && stream.status() == QDataStream::Ok; ++i )
+	{
+		QString dirPath;
+		Entry entry;
+		stream >> dirPath >> entry.modified >> entry.dirNames >> entry.fileNames;
+
+		if ( stream.status() == QDataStream::Ok )
+			entryForDirPath_[ dirPath ] = entry;
+	}
+
+	if ( stream.status() != QDataStream::Ok )
+		foggWarning() << "Scan index is truncated:" << file.fileName();
+}
+
+
+void ScanIndex::save()
+{
+	QMutexLocker locker( &mutex_ );
+
+	if ( !isChanged_ )
+		return;
+
+	const QString filePath = _filePath();
+	QDir().mkpath( QFileInfo( filePath ).path() );
+
+	QSaveFile file( filePath );
+	if ( !file.open( QIODevice::WriteOnly ) )
+	{
+		foggWarning() << "Error opening scan index for write:" << filePath;
+		return;
+	}
+
+	QDataStream stream( &file );
+	stream << kScanIndexMagic << kScanIndexVersion << qint32(entryForDirPath_.count());
+
+	for ( QHash<QString,Entry>::const_iterator it = entryForDirPath_.constBegin(); it != entryForDirPath_.constEnd(); ++it )
+		stream << it.key() << it.value().modified << it.value().dirNames << it.value().fileNames;
+
+	if ( !file.commit() )
+	{
+		foggWarning() << "Error writing scan index:" << filePath;
+		return;
+	}
+
+	isChanged_ = false;
+}
+
+
+bool ScanIndex::find( const QString & dirPath, const qint64 modified, QStringList & dirNames, QStringList & fileNames ) const
+{
+	QMutexLocker locker( &mutex_ );
+
+	const QHash<QString,Entry>::const_iterator it = entryForDirPath_.constFind( dirPath );
+	if ( it == entryForDirPath_.constEnd() || it.value().modified != modified )
+		return false;
+
+	dirNames = it.value().dirNames;
+	fileNames = it.value().fileNames;
+	return true;
+}
+
+
+void ScanIndex::insert( const QString & dirPath, const qint64 modified, const QStringList & dirNames, const QStringList & fileNames )
+{
+	const bool isRacy = QDateTime::currentMSecsSinceEpoch() - modified < kRacyModificationInterval;
+
+	QMutexLocker locker( &mutex_ );
+
+	QHash<QString,Entry>::iterator it = entryForDirPath_.find( dirPath );
+
+	if ( it != entryForDirPath_.end() )
+	{
+		// forget subdirectories removed since the previous scan together with everything below them,
+		// nothing would ever look those entries up again
+		const QString pathPrefix = dirPath.endsWith( QLatin1Char( '/' ) ) ? dirPath : dirPath + QLatin1Char( '/' );
+		const QSet<QString> dirNameSet = dirNames.toSet();
+		QStringList removedDirPaths;
+		foreach ( const QString & dirName, it.value().dirNames )
+			if ( !dirNameSet.contains( dirName ) )
+				removedDirPaths << pathPrefix + dirName;
+
+		if ( !removedDirPaths.isEmpty() )
+		{
+			for ( QHash<QString,Entry>::iterator removeIt = entryForDirPath_.begin(); removeIt != entryForDirPath_.end(); )
+			{
+				bool isRemoved = false;
+				foreach ( const QString & removedDirPath, removedDirPaths )
+				{
+					if ( removeIt.key().startsWith( removedDirPath ) && (removeIt.key().length() == removedDirPath.length() ||
+							removeIt.key().at( removedDirPath.length() ) == QLatin1Char( '/' )) )
+					{
+						isRemoved = true;
+						break;
+					}
+				}
+
+				if ( isRemoved )
+					removeIt = entryForDirPath_.erase( removeIt );
+				else
+					++removeIt;
+			}
+		}
+
+		it = entryForDirPath_.find( dirPath );
+	}
+
+	isChanged_ = true;
+
+	if ( isRacy )
+	{
+		if ( it != entryForDirPath_.end() )
+			entryForDirPath_.erase( it );
+		return;
+	}
+
+	Entry & entry = entryForDirPath_[ dirPath ];
+	entry.modified = modified;
+	entry.dirNames = dirNames;
+	entry.fileNames = fileNames;
+}
+
+
+
+
+} // namespace Fogg
@@ -0,0 +1,56 @@
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMutex>
+
+
+
+
+namespace Fogg {
+
+
+
+
+// Remembers entries of scanned directories together with directory modification time,
+// so FileFetcher lists only directories changed since the previous scan.
+// Names are stored unfiltered, the index does not depend on file filters.
+// Accessed from scan threads, all public methods are thread safe.
+class ScanIndex
+{
+public:
+	ScanIndex();
+
+	void load();
+	void save();
+
+	bool find( const QString & dirPath, qint64 modified, QStringList & dirNames, QStringList & fileNames ) const;
+	void insert( const QString & dirPath, qint64 modified, const QStringList & dirNames, const QStringList & fileNames );
+
+private:
+	class Entry
+	{
+	public:
+		Entry() :
+			modified( 0 )
+		{}
+
+		qint64 modified;
+		QStringList dirNames;
+		QStringList fileNames;
+	};
+
+	static QString _filePath();
+
+private:
+	mutable QMutex mutex_;
+	QHash<QString,Entry> entryForDirPath_;
+	bool isChanged_;
+};
+
+
+
+
+} // namespace Fogg
@@ -0,0 +1,229 @@
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QMetaObject>
+
+#include <cstdio>
+
+#include "Global.h"
+#include "Config.h"
+#include "Converter.h"
+#include "ConversionManifest.h"
+#include "ScanIndex.h"
+#include "ConsoleConverter.h"
+
+
+
+
+static int _usageError( const QString & message )
+{
+	fprintf( stderr, "%s\n", qPrintable( message ) );
+	return 2;
+}
+
+
+static bool _parseBitrate( const QString & value, int & bitrate )
+{
+	bool isValid;
+	bitrate = value.toInt( &isValid );
+	return isValid && bitrate >= Fogg::kMinimumBitrateValue && bitrate <= Fogg::kMaximumBitrateValue;
+}
+
+
+int main( int argc, char ** argv )
+{
+	QCoreApplication app( argc, argv );
+
+	// share settings with GUI application to access its profiles
+	app.setOrganizationName( "dendy.org" );
+	app.setOrganizationDomain( "www.dendy.org" );
+	app.setApplicationName( "fogg" );
+	app.setApplicationVersion( Fogg::Global::applicationVersion() );
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription( "Converts audio files into Ogg/Vorbis." );
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.addPositionalArgument( "sources", "Source files and directories.", "<source>..." );
+
+	const QCommandLineOption destinationOption( QStringList() << "d" << "destination",
+			"Root directory for converted files, keeps source directory hierarchy.", "path" );
+	const QCommandLineOption qualityOption( QStringList() << "q" << "quality",
+			"Vorbis quality in range [-0.1 .. 1.0].", "value" );
+	const QCommandLineOption bitrateOption( QStringList() << "b" << "bitrate",
+			"Managed average bitrate in kbit/s, replaces quality.", "kbps" );
+	const QCommandLineOption minimumBitrateOption( "minimum-bitrate",
+			"Hard lower bitrate limit in kbit/s for managed bitrate.", "kbps" );
+	const QCommandLineOption maximumBitrateOption( "maximum-bitrate",
+			"Hard upper bitrate limit in kbit/s for managed bitrate.", "kbps" );
+	const QCommandLineOption constantBitrateOption( "constant-bitrate",
+			"Keep managed bitrate constant." );
+	const QCommandLineOption sampleRateOption( QStringList() << "r" << "sample-rate",
+			"Resample to the given rate in Hz, 0 keeps source rate.", "hz" );
+	const QCommandLineOption threadsOption( QStringList() << "j" << "threads",
+			"Number of concurrent conversions, 0 means auto.", "count" );
+	const QCommandLineOption profileOption( QStringList() << "p" << "profile",
+			"Take destination, quality, bitrate, sample rate and album options from the named profile.", "name" );
+	const QCommandLineOption prependYearToAlbumOption( "prepend-year-to-album",
+			"Prepend year to album tag." );
+	const QCommandLineOption splitLongFilesOption( "split-long-files",
+			"Encode long files on several threads." );
+	const QCommandLineOption syncOption( "sync",
+			"Flush each converted file to disk before it replaces destination." );
+	const QCommandLineOption forceOption( "force",
+			"Convert files even if destinations are up to date." );
+
+	parser.addOption( destinationOption );
+	parser.addOption( qualityOption );
+	parser.addOption( bitrateOption );
+	parser.addOption( minimumBitrateOption );
+	parser.addOption( maximumBitrateOption );
+	parser.addOption( constantBitrateOption );
+	parser.addOption( sampleRateOption );
+	parser.addOption( threadsOption );
+	parser.addOption( profileOption );
+	parser.addOption( prependYearToAlbumOption );
+	parser.addOption( splitLongFilesOption );
+	parser.addOption( syncOption );
+	parser.addOption( forceOption );
+
+	parser.process( app );
+
+	Fogg::Config config;
+	config.load();
+
+	QString destinationPath;
+	Fogg::EncoderSettings encoderSettings = Fogg::EncoderSettings::fromQuality( config.defaultQuality() );
+	int sampleRate = 0;
+	bool prependYearToAlbum = false;
+
+	if ( parser.isSet( profileOption ) )
+	{
+		const QString profileName = parser.value( profileOption );
+
+		Fogg::Config::Profile profile;
+		foreach ( const int customProfileId, config.customProfileIds() )
+		{
+			if ( config.customProfileForId( customProfileId ).name == profileName )
+			{
+				profile = config.customProfileForId( customProfileId );
+				break;
+			}
+		}
+
+		if ( profile.isNull() )
+			return _usageError( QString::fromLatin1( "Profile not found: %1" ).arg( profileName ) );
+
+		destinationPath = profile.path;
+		encoderSettings = profile.encoderSettings;
+		sampleRate = profile.sampleRate;
+		prependYearToAlbum = profile.prependYearToAlbum;
+	}
+
+	if ( parser.isSet( destinationOption ) )
+		destinationPath = parser.value( destinationOption );
+
+	if ( parser.isSet( qualityOption ) && parser.isSet( bitrateOption ) )
+		return _usageError( "Quality and bitrate cannot be used together." );
+
+	if ( parser.isSet( qualityOption ) )
+	{
+		bool isValid;
+		const qreal quality = parser.value( qualityOption ).toDouble( &isValid );
+		if ( !isValid || quality < Fogg::kMinimumQualityValue || quality > Fogg::kMaximumQualityValue )
+			return _usageError( QString::fromLatin1( "Invalid quality: %1" ).arg( parser.value( qualityOption ) ) );
+		encoderSettings = Fogg::EncoderSettings::fromQuality( quality );
+	}
+
+	if ( parser.isSet( bitrateOption ) )
+	{
+		int bitrate;
+		if ( !_parseBitrate( parser.value( bitrateOption ), bitrate ) )
+			return _usageError( QString::fromLatin1( "Invalid bitrate: %1" ).arg( parser.value( bitrateOption ) ) );
+
+		int minimumBitrate = -1;
+		if ( parser.isSet( minimumBitrateOption ) && !_parseBitrate( parser.value( minimumBitrateOption ), minimumBitrate ) )
+			return _usageError( QString::fromLatin1( "Invalid minimum bitrate: %1" ).arg( parser.value( minimumBitrateOption ) ) );
+
+		int maximumBitrate = -1;
+		if ( parser.isSet( maximumBitrateOption ) && !_parseBitrate( parser.value( maximumBitrateOption ), maximumBitrate ) )
+			return _usageError( QString::fromLatin1( "Invalid maximum bitrate: %1" ).arg( parser.value( maximumBitrateOption ) ) );
+
+		if ( parser.isSet( constantBitrateOption ) )
+		{
+			if ( minimumBitrate != -1 || maximumBitrate != -1 )
+				return _usageError( "Bitrate limits cannot be used with constant bitrate." );
+			encoderSettings = Fogg::EncoderSettings::fromConstantBitrate( bitrate );
+		}
+		else
+		{
+			encoderSettings = Fogg::EncoderSettings::fromAverageBitrate( bitrate, minimumBitrate, maximumBitrate );
+			if ( !encoderSettings.isValid() )
+				return _usageError( "Bitrate limits must enclose the bitrate." );
+		}
+	}
+	else if ( parser.isSet( minimumBitrateOption ) || parser.isSet( maximumBitrateOption ) ||
+			parser.isSet( constantBitrateOption ) )
+	{
+		return _usageError( "Bitrate is not specified." );
+	}
+
+	if ( parser.isSet( sampleRateOption ) )
+	{
+		bool isValid;
+		sampleRate = parser.value( sampleRateOption ).toInt( &isValid );
+		if ( !isValid || (sampleRate != 0 && (sampleRate < Fogg::kMinimumSampleRateValue || sampleRate > Fogg::kMaximumSampleRateValue)) )
+			return _usageError( QString::fromLatin1( "Invalid sample rate: %1" ).arg( parser.value( sampleRateOption ) ) );
+	}
+
+	if ( parser.isSet( prependYearToAlbumOption ) )
+		prependYearToAlbum = true;
+
+	int threadCount = config.concurrentThreadCount();
+	if ( parser.isSet( threadsOption ) )
+	{
+		bool isValid;
+		threadCount = parser.value( threadsOption ).toInt( &isValid );
+		if ( !isValid || threadCount < 0 )
+			return _usageError( QString::fromLatin1( "Invalid thread count: %1" ).arg( parser.value( threadsOption ) ) );
+	}
+
+	if ( destinationPath.isEmpty() )
+		return _usageError( "Destination directory is not specified." );
+
+	if ( parser.positionalArguments().isEmpty() )
+		return _usageError( "No sources specified." );
+
+	Fogg::ConversionManifest conversionManifest;
+	conversionManifest.load();
+
+	Fogg::Converter converter;
+	converter.setConcurrentThreadCount( threadCount );
+	converter.setSplitLongFiles( parser.isSet( splitLongFilesOption ) );
+	converter.setSyncOutputFiles( parser.isSet( syncOption ) );
+	if ( !parser.isSet( forceOption ) )
+		converter.setConversionManifest( &conversionManifest );
+
+	Fogg::ConsoleConverter consoleConverter( &converter );
+	consoleConverter.setSourcePaths( parser.positionalArguments() );
+	consoleConverter.setDestinationPath( destinationPath );
+	consoleConverter.setEncoderSettings( encoderSettings );
+	consoleConverter.setSampleRate( sampleRate );
+	consoleConverter.setPrependYearToAlbum( prependYearToAlbum );
+
+	Fogg::ScanIndex scanIndex;
+	scanIndex.load();
+	consoleConverter.setScanIndex( &scanIndex );
+
+	QObject::connect( &consoleConverter, SIGNAL(finished()), &app, SLOT(quit()) );
+	QMetaObject::invokeMethod( &consoleConverter, "start", Qt::QueuedConnection );
+
+	app.exec();
+
+	converter.wait();
+
+	conversionManifest.save();
+	scanIndex.save();
+
+	return consoleConverter.failedJobCount() == 0 ? 0 : 1;
+}
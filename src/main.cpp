@@ -4,6 +4,8 @@
 #include "Global.h"
 #include "Config.h"
 #include "Converter.h"
+#include "ConversionManifest.h"
+#include "ScanIndex.h"
 #include "MainWindow.h"
 
 
@@ -27,10 +29,18 @@ int main( int argc, char ** argv )
 	Fogg::Config config;
 	config.load();
 
+	Fogg::ConversionManifest conversionManifest;
+	conversionManifest.load();
+
 	Fogg::Converter converter;
 	converter.setConcurrentThreadCount( config.concurrentThreadCount() );
+	converter.setSplitLongFiles( config.splitLongFiles() );
+	converter.setConversionManifest( &conversionManifest );
+
+	Fogg::ScanIndex scanIndex;
+	scanIndex.load();
 
-	Fogg::MainWindow mainWindow( &config, &converter );
+	Fogg::MainWindow mainWindow( &config, &converter, &scanIndex );
 
 	if ( config.mainWindowMaximized() )
 		mainWindow.showMaximized();
@@ -45,6 +55,8 @@ int main( int argc, char ** argv )
 	converter.wait();
 
 	config.save();
+	conversionManifest.save();
+	scanIndex.save();
 
 	return exitCode;
 }
@@ -0,0 +1,549 @@
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+#include <grim/audio/FormatManager.h>
+#include <grim/audio/FormatPlugin.h>
+
+#include <vorbis/vorbisenc.h>
+
+#include "JobItemModel.h"
+#include "EncoderSettings.h"
+#include "EncoderSetupCache.h"
+
+
+
+
+using namespace Fogg;
+
+
+
+
+// files are added in batches like FileFetcher posts them
+static const int kAddFilesBatchSize = 1000;
+
+// each opened file is read a bit, like Job does before the first encoder block
+static const int kOpenFilesReadSize = 64*1024;
+
+// Job reads this many samples at once, small reads make decoders keep the rest of each frame
+static const int kReadFileJobSampleCount = 64*1024;
+static const int kReadFileSmallReadSize = 4096;
+
+// short clips of a sound effect library
+static const int kEncodeClipChannelCount = 2;
+static const int kEncodeClipFrequency = 44100;
+static const int kEncodeClipSampleCount = kEncodeClipFrequency;
+static const qreal kEncodeClipQuality = 0.5;
+static const int kEncodeBlockSampleCount = 1024;
+
+
+
+
+static int _intArgument( const QStringList & args, const int index, const int defaultValue )
+{
+	if ( index >= args.count() )
+		return defaultValue;
+
+	bool isOk = false;
+	const int value = args.at( index ).toInt( &isOk );
+	return isOk && value > 0 ? value : defaultValue;
+}
+
+
+static void _printRate( const char * const name, const int count, const qint64 nsecs )
+{
+	printf( "%-28s %8d in %8.1f ms, %8.0f ns each\n", name, count, nsecs/1e6, count == 0 ? 0.0 : double(nsecs)/count );
+}
+
+
+
+
+// glibc lets executable replace allocation and copy functions for the whole process,
+// so heap allocations and memcpy() calls of decoder libraries are counted as well
+#ifdef __GLIBC__
+static const bool kCanCountAllocations = true;
+
+static QBasicAtomicInteger<qint64> allocationCounter = Q_BASIC_ATOMIC_INITIALIZER( 0 );
+static QBasicAtomicInteger<qint64> copiedByteCounter = Q_BASIC_ATOMIC_INITIALIZER( 0 );
+
+extern "C" void * __libc_malloc( size_t size );
+extern "C" void * __libc_calloc( size_t count, size_t size );
+extern "C" void * __libc_realloc( void * data, size_t size );
+
+extern "C" void * malloc( size_t size ) __THROW
+{
+	allocationCounter.fetchAndAddRelaxed( 1 );
+	return __libc_malloc( size );
+}
+
+extern "C" void * calloc( size_t count, size_t size ) __THROW
+{
+	allocationCounter.fetchAndAddRelaxed( 1 );
+	return __libc_calloc( count, size );
+}
+
+extern "C" void * realloc( void * data, size_t size ) __THROW
+{
+	allocationCounter.fetchAndAddRelaxed( 1 );
+	return __libc_realloc( data, size );
+}
+
+extern "C" void * memcpy( void * to, const void * from, size_t size ) __THROW
+{
+	copiedByteCounter.fetchAndAddRelaxed( qint64(size) );
+	return memmove( to, from, size );
+}
+
+static qint64 _allocationCount()
+{ return allocationCounter.load(); }
+
+static qint64 _copiedByteCount()
+{ return copiedByteCounter.load(); }
+#else
+static const bool kCanCountAllocations = false;
+
+static qint64 _allocationCount()
+{ return 0; }
+
+static qint64 _copiedByteCount()
+{ return 0; }
+#endif
+
+
+
+
+// Adds fileCount synthetic paths to a fresh model, either all into one directory or spread over a tree.
+static qint64 _addFiles( const int fileCount, const bool isFlat )
+{
+	JobItemModel model;
+	model.setSourcePaths( QStringList() << QLatin1String( "/bench" ) );
+
+	QVector<JobItemModel::FetchedFile> files;
+	files.reserve( fileCount );
+	for ( int i = 0; i < fileCount; ++i )
+	{
+		const QString fileName = QString::fromLatin1( "%1.flac" ).arg( i, 6, 10, QLatin1Char( '0' ) );
+		const QString filePath = isFlat ?
+				QString::fromLatin1( "/bench/flat/%1" ).arg( fileName ) :
+				QString::fromLatin1( "/bench/tree/artist%1/album%2/%3" ).arg( i/1000 ).arg( (i/50)%20 ).arg( fileName );
+		files << JobItemModel::FetchedFile( filePath, QLatin1String( "/bench" ), QLatin1String( "flac" ) );
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	for ( int i = 0; i < fileCount; i += kAddFilesBatchSize )
+		model.addFiles( files.mid( i, kAddFilesBatchSize ) );
+
+	const qint64 nsecs = timer.nsecsElapsed();
+	Q_ASSERT( model.allFileItems().count() == fileCount );
+
+	return nsecs;
+}
+
+
+// Per file cost should stay flat while the count doubles, if insertion is near linear.
+static int _benchAddFiles( const QStringList & args )
+{
+	const int fileCount = _intArgument( args, 0, 100000 );
+
+	for ( int pass = 0; pass < 2; ++pass )
+	{
+		const bool isFlat = pass == 0;
+		for ( int shift = 3; shift >= 0; --shift )
+		{
+			const int count = fileCount >> shift;
+			if ( count > 0 )
+				_printRate( isFlat ? "add files, flat dir" : "add files, tree", count, _addFiles( count, isFlat ) );
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+// Opens files from the given list round robin until count files are opened, checking each one
+// resolves to the same format and channel count as a single threaded open did.
+class OpenFilesRunnable : public QRunnable
+{
+public:
+	OpenFilesRunnable( Grim::Audio::FormatManager * const formatManager, const QStringList & filePaths,
+			const QStringList & expectedFormats, const int count, QAtomicInt * const nextIndex,
+			QAtomicInt * const failedCount ) :
+		formatManager_( formatManager ), filePaths_( filePaths ), expectedFormats_( expectedFormats ),
+		count_( count ), nextIndex_( nextIndex ), failedCount_( failedCount )
+	{}
+
+	void run()
+	{
+		QByteArray buffer( kOpenFilesReadSize, 0 );
+
+		for ( ; ; )
+		{
+			const int index = nextIndex_->fetchAndAddOrdered( 1 );
+			if ( index >= count_ )
+				break;
+
+			const int fileIndex = index % filePaths_.count();
+			Grim::Audio::FormatFile * const file = formatManager_->createFormatFile( filePaths_.at( fileIndex ), QString() );
+
+			if ( !file || file->resolvedFormat() != expectedFormats_.at( fileIndex ) ||
+					file->device()->read( buffer.data(), buffer.size() ) < 0 )
+			{
+				failedCount_->ref();
+				printf( "FAIL opening %s\n", qPrintable( filePaths_.at( fileIndex ) ) );
+			}
+
+			delete file;
+		}
+	}
+
+private:
+	Grim::Audio::FormatManager * formatManager_;
+	QStringList filePaths_;
+	QStringList expectedFormats_;
+	int count_;
+	QAtomicInt * nextIndex_;
+	QAtomicInt * failedCount_;
+};
+
+
+// Returns number of failed opens, elapsed time is stored to nsecs.
+static int _openFiles( Grim::Audio::FormatManager * const formatManager, const QStringList & filePaths,
+		const QStringList & expectedFormats, const int count, const int threadCount, qint64 & nsecs )
+{
+	QAtomicInt nextIndex( 0 );
+	QAtomicInt failedCount( 0 );
+
+	QThreadPool threadPool;
+	threadPool.setMaxThreadCount( threadCount );
+
+	QElapsedTimer timer;
+	timer.start();
+
+	for ( int i = 0; i < threadCount; ++i )
+		threadPool.start( new OpenFilesRunnable( formatManager, filePaths, expectedFormats, count, &nextIndex, &failedCount ) );
+	threadPool.waitForDone();
+
+	nsecs = timer.nsecsElapsed();
+	return failedCount.load();
+}
+
+
+// All threads open files at the same moment, as worker threads do at the batch start.
+static int _benchOpenFiles( const QStringList & args )
+{
+	if ( args.count() < 3 )
+	{
+		printf( "open-files needs count, thread count and at least one file\n" );
+		return 1;
+	}
+
+	const int count = _intArgument( args, 0, 10000 );
+	const int threadCount = _intArgument( args, 1, QThread::idealThreadCount() );
+	const QStringList filePaths = args.mid( 2 );
+
+	Grim::Audio::FormatManager formatManager;
+
+	QStringList expectedFormats;
+	foreach ( const QString & filePath, filePaths )
+	{
+		Grim::Audio::FormatFile * const file = formatManager.createFormatFile( filePath, QString() );
+		if ( !file )
+		{
+			printf( "cannot open %s\n", qPrintable( filePath ) );
+			return 1;
+		}
+		expectedFormats << file->resolvedFormat();
+		delete file;
+	}
+
+	qint64 nsecs = 0;
+	int failedCount = _openFiles( &formatManager, filePaths, expectedFormats, count, 1, nsecs );
+	_printRate( "open files, 1 thread", count, nsecs );
+
+	failedCount += _openFiles( &formatManager, filePaths, expectedFormats, count, threadCount, nsecs );
+	_printRate( qPrintable( QString::fromLatin1( "open files, %1 threads" ).arg( threadCount ) ), count, nsecs );
+
+	return failedCount == 0 ? 0 : 1;
+}
+
+
+
+
+enum ReadMode
+{
+	ReadMode_SmallReads,
+	ReadMode_JobReads
+};
+
+
+// Decodes the whole file, returns false on error.
+// Float decoders are read with readFloat() into planar buffers in job mode, exactly as Job does.
+static bool _readFile( Grim::Audio::FormatManager * const formatManager, const QString & filePath,
+		const ReadMode readMode, double & seconds, qint64 & nsecs, qint64 & allocationCount, qint64 & copiedByteCount )
+{
+	Grim::Audio::FormatFile * const file = formatManager->createFormatFile( filePath, QString() );
+	if ( !file )
+		return false;
+
+	const bool isFloat = readMode == ReadMode_JobReads && file->canReadFloat();
+	const qint64 size = readMode == ReadMode_SmallReads ? kReadFileSmallReadSize :
+			file->samplesToBytes( kReadFileJobSampleCount );
+
+	QByteArray buffer( int(size), 0 );
+	QVector<float> floatBuffer( isFloat ? file->channels()*kReadFileJobSampleCount : 0 );
+	QVector<float*> channels( file->channels() );
+	for ( int channelIndex = 0; channelIndex < channels.count(); ++channelIndex )
+		channels[ channelIndex ] = floatBuffer.data() + channelIndex*kReadFileJobSampleCount;
+
+	qint64 totalSamples = 0;
+	bool isOk = true;
+
+	const qint64 startAllocationCount = _allocationCount();
+	const qint64 startCopiedByteCount = _copiedByteCount();
+
+	QElapsedTimer timer;
+	timer.start();
+
+	for ( ; ; )
+	{
+		const qint64 samples = isFloat ?
+				file->readFloat( channels.constData(), kReadFileJobSampleCount ) :
+				file->bytesToSamples( qMax<qint64>( 0, file->device()->read( buffer.data(), size ) ) );
+		if ( samples == -1 )
+		{
+			isOk = false;
+			break;
+		}
+		if ( samples == 0 )
+			break;
+		totalSamples += samples;
+	}
+
+	nsecs = timer.nsecsElapsed();
+	allocationCount = _allocationCount() - startAllocationCount;
+	copiedByteCount = _copiedByteCount() - startCopiedByteCount;
+	seconds = double(totalSamples)/file->frequency();
+
+	delete file;
+	return isOk;
+}
+
+
+// Decodes the whole file with small reads thru QIODevice and with reads Job does.
+// Frames bigger than small reads exercise decoder side buffering of the rest of each frame.
+// Allocations and copies are counted for the whole process, including decoder libraries.
+static int _benchReadFile( const QStringList & args )
+{
+	if ( args.isEmpty() )
+	{
+		printf( "read-file needs a file\n" );
+		return 1;
+	}
+
+	const QString filePath = args.at( 0 );
+	const int passCount = _intArgument( args, 1, 3 );
+
+	Grim::Audio::FormatManager formatManager;
+
+	for ( int pass = 0; pass < passCount; ++pass )
+	{
+		for ( int modeIndex = 0; modeIndex < 2; ++modeIndex )
+		{
+			const ReadMode readMode = modeIndex == 0 ? ReadMode_SmallReads : ReadMode_JobReads;
+
+			double seconds = 0;
+			qint64 nsecs = 0;
+			qint64 allocationCount = 0;
+			qint64 copiedByteCount = 0;
+			if ( !_readFile( &formatManager, filePath, readMode, seconds, nsecs, allocationCount, copiedByteCount ) )
+			{
+				printf( "cannot read %s\n", qPrintable( filePath ) );
+				return 1;
+			}
+
+			printf( "read file, %-10s %8.1f s in %8.1f ms, %6.1f decoded seconds per second",
+					readMode == ReadMode_SmallReads ? "4KB reads" : "job reads", seconds, nsecs/1e6,
+					nsecs == 0 ? 0.0 : seconds*1e9/nsecs );
+			if ( kCanCountAllocations && seconds > 0 )
+				printf( ", %8.1f allocations and %8.2f MB memcpy per decoded second",
+						allocationCount/seconds, copiedByteCount/1e6/seconds );
+			printf( "\n" );
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+// Encodes a clip of a quiet sine wave like Job does, except packets are not paged and dropped.
+// Returns number of encoded bytes including headers.
+static qint64 _encodeClip( vorbis_info * const vi, EncoderSetupCache::Setup * const encoderSetup )
+{
+	vorbis_comment vc;
+	vorbis_comment_init( &vc );
+	vorbis_comment_add_tag( &vc, "TITLE", "bench" );
+
+	vorbis_dsp_state vd;
+	vorbis_analysis_init( &vd, vi );
+
+	vorbis_block vb;
+	vorbis_block_init( &vd, &vb );
+
+	ogg_packet header, header_comm, header_code;
+	if ( encoderSetup )
+		encoderSetup->headerOut( &vd, &vc, &header, &header_comm, &header_code );
+	else
+		vorbis_analysis_headerout( &vd, &vc, &header, &header_comm, &header_code );
+
+	qint64 bytes = header.bytes + header_comm.bytes + header_code.bytes;
+
+	if ( encoderSetup )
+		ogg_packet_clear( &header_comm );
+
+	for ( int offset = 0; ; offset += kEncodeBlockSampleCount )
+	{
+		const int sampleCount = qMin( kEncodeBlockSampleCount, kEncodeClipSampleCount - offset );
+		if ( sampleCount > 0 )
+		{
+			float ** const buffer = vorbis_analysis_buffer( &vd, sampleCount );
+			for ( int channelIndex = 0; channelIndex < kEncodeClipChannelCount; ++channelIndex )
+				for ( int i = 0; i < sampleCount; ++i )
+					buffer[ channelIndex ][ i ] = 0.25f*std::sin( (offset + i)*0.0625f*(channelIndex + 1) );
+		}
+		vorbis_analysis_wrote( &vd, qMax( 0, sampleCount ) );
+
+		ogg_packet op;
+		while ( vorbis_analysis_blockout( &vd, &vb ) == 1 )
+		{
+			vorbis_analysis( &vb, 0 );
+			vorbis_bitrate_addblock( &vb );
+			while ( vorbis_bitrate_flushpacket( &vd, &op ) )
+				bytes += op.bytes;
+		}
+
+		if ( sampleCount <= 0 )
+			break;
+	}
+
+	vorbis_block_clear( &vb );
+	vorbis_dsp_clear( &vd );
+	vorbis_comment_clear( &vc );
+
+	return bytes;
+}
+
+
+// Per clip cost with encoder set up from scratch for each clip, as every Job did before,
+// and with setups taken from EncoderSetupCache.
+static int _benchEncoderSetup( const QStringList & args )
+{
+	const int clipCount = _intArgument( args, 0, 1000 );
+	const EncoderSettings settings = EncoderSettings::fromQuality( kEncodeClipQuality );
+
+	for ( int pass = 0; pass < 2; ++pass )
+	{
+		const bool isCached = pass == 1;
+		qint64 bytes = 0;
+
+		QElapsedTimer timer;
+		timer.start();
+
+		for ( int i = 0; i < clipCount; ++i )
+		{
+			if ( isCached )
+			{
+				EncoderSetupCache::Setup * const encoderSetup = EncoderSetupCache::setupForCurrentThread(
+						settings, kEncodeClipChannelCount, kEncodeClipFrequency );
+				if ( !encoderSetup )
+				{
+					printf( "cannot set up encoder\n" );
+					return 1;
+				}
+				bytes += _encodeClip( encoderSetup->info(), encoderSetup );
+			}
+			else
+			{
+				vorbis_info vi;
+				vorbis_info_init( &vi );
+				if ( !settings.initVorbisInfo( &vi, kEncodeClipChannelCount, kEncodeClipFrequency ) )
+				{
+					vorbis_info_clear( &vi );
+					printf( "cannot set up encoder\n" );
+					return 1;
+				}
+				bytes += _encodeClip( &vi, 0 );
+				vorbis_info_clear( &vi );
+			}
+		}
+
+		_printRate( isCached ? "encode clips, cached setup" : "encode clips, fresh setup", clipCount, timer.nsecsElapsed() );
+		printf( "%-28s %8.1f KB per clip\n", "", clipCount == 0 ? 0.0 : bytes/1024.0/clipCount );
+	}
+
+	return 0;
+}
+
+
+
+
+struct Benchmark
+{
+	const char * name;
+	const char * arguments;
+	int ( *function )( const QStringList & args );
+};
+
+static const Benchmark kBenchmarks[] = {
+	{ "add-files",     "[count]",                            _benchAddFiles },
+	{ "open-files",    "<count> <threads> <file> [file...]", _benchOpenFiles },
+	{ "read-file",     "<file> [passes]",                    _benchReadFile },
+	{ "encoder-setup", "[clips]",                            _benchEncoderSetup }
+};
+
+static const int kBenchmarkCount = sizeof(kBenchmarks)/sizeof(Benchmark);
+
+
+
+
+static void _printUsage()
+{
+	printf( "usage: fogg-bench <benchmark> [arguments]\n" );
+	for ( int i = 0; i < kBenchmarkCount; ++i )
+		printf( "    %s %s\n", kBenchmarks[ i ].name, kBenchmarks[ i ].arguments );
+}
+
+
+int main( int argc, char ** argv )
+{
+	QCoreApplication app( argc, argv );
+
+	const QStringList args = app.arguments().mid( 1 );
+	if ( args.isEmpty() )
+	{
+		_printUsage();
+		return 1;
+	}
+
+	for ( int i = 0; i < kBenchmarkCount; ++i )
+		if ( args.first() == QLatin1String( kBenchmarks[ i ].name ) )
+			return kBenchmarks[ i ].function( args.mid( 1 ) );
+
+	_printUsage();
+	return 1;
+}
@@ -0,0 +1,130 @@
+#include <QVector>
+
+#include <cstdio>
+#include <cstring>
+
+#include "Deinterleaver.h"
+
+
+
+
+using namespace Fogg;
+
+
+
+
+static const int kBitsPerSampleValues[] = { 8, 16, 24, 32 };
+
+// vector widths and their neighbours, so each kernel goes thru its main loop and its scalar tail
+static const int kSampleCounts[] = { 0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1000, 4099 };
+
+// vectorized kernels must not touch output past sampleCount
+static const int kGuardSampleCount = 16;
+static const float kGuardValue = -1234.5f;
+
+
+
+
+static const char * _nameForInstructionSet( const Deinterleaver::InstructionSet instructionSet )
+{
+	switch ( instructionSet )
+	{
+	case Deinterleaver::InstructionSet_Scalar: return "scalar";
+	case Deinterleaver::InstructionSet_Sse2:   return "sse2";
+	case Deinterleaver::InstructionSet_Avx2:   return "avx2";
+	}
+	return "unknown";
+}
+
+
+// Fills with deterministic noise, covering every bit pattern including the most negative values.
+static void _fillNoise( QVector<char> & data, quint32 seed )
+{
+	for ( int i = 0; i < data.size(); ++i )
+	{
+		seed = seed*1664525 + 1013904223;
+		data[ i ] = char(seed >> 24);
+	}
+}
+
+
+static void _convert( const Deinterleaver::Kernel kernel, const char * const rawData, const int sampleCount,
+		const int channelCount, QVector<float> & output )
+{
+	const int stride = sampleCount + kGuardSampleCount;
+	output.fill( kGuardValue, channelCount*stride );
+
+	float * channels[ Deinterleaver::kMaxChannelCount ];
+	for ( int channelIndex = 0; channelIndex < channelCount; ++channelIndex )
+		channels[ channelIndex ] = output.data() + channelIndex*stride;
+
+	kernel( rawData, channels, sampleCount, channelCount );
+}
+
+
+// Returns number of failed cases for the given instruction set.
+static int _testInstructionSet( const Deinterleaver::InstructionSet instructionSet )
+{
+	int failedCount = 0;
+	int caseCount = 0;
+
+	for ( int channelCount = 1; channelCount <= Deinterleaver::kMaxChannelCount; ++channelCount )
+	{
+		for ( size_t bitsIndex = 0; bitsIndex < sizeof(kBitsPerSampleValues)/sizeof(int); ++bitsIndex )
+		{
+			const int bitsPerSample = kBitsPerSampleValues[ bitsIndex ];
+			const Deinterleaver::Kernel referenceKernel =
+					Deinterleaver::kernel( channelCount, bitsPerSample, Deinterleaver::InstructionSet_Scalar );
+			const Deinterleaver::Kernel kernel = Deinterleaver::kernel( channelCount, bitsPerSample, instructionSet );
+
+			for ( size_t countIndex = 0; countIndex < sizeof(kSampleCounts)/sizeof(int); ++countIndex )
+			{
+				const int sampleCount = kSampleCounts[ countIndex ];
+
+				// one extra byte to read from an odd address too
+				QVector<char> rawData( sampleCount*channelCount*bitsPerSample/8 + 1 );
+				_fillNoise( rawData, quint32(channelCount*1000 + bitsPerSample*10 + countIndex) );
+
+				for ( int rawOffset = 0; rawOffset < 2; ++rawOffset )
+				{
+					QVector<float> expected;
+					QVector<float> actual;
+					_convert( referenceKernel, rawData.constData() + rawOffset, sampleCount, channelCount, expected );
+					_convert( kernel, rawData.constData() + rawOffset, sampleCount, channelCount, actual );
+
+					caseCount++;
+					if ( memcmp( expected.constData(), actual.constData(), expected.size()*sizeof(float) ) != 0 )
+					{
+						failedCount++;
+						printf( "FAIL %s: %d channels, %d bits, %d samples, raw offset %d\n",
+								_nameForInstructionSet( instructionSet ), channelCount, bitsPerSample, sampleCount, rawOffset );
+					}
+				}
+			}
+		}
+	}
+
+	printf( "%s: %d of %d cases match scalar kernel\n",
+			_nameForInstructionSet( instructionSet ), caseCount - failedCount, caseCount );
+
+	return failedCount;
+}
+
+
+int main()
+{
+	const Deinterleaver::InstructionSet bestInstructionSet = Deinterleaver::bestInstructionSet();
+
+	int failedCount = 0;
+
+	if ( bestInstructionSet >= Deinterleaver::InstructionSet_Sse2 )
+		failedCount += _testInstructionSet( Deinterleaver::InstructionSet_Sse2 );
+
+	if ( bestInstructionSet >= Deinterleaver::InstructionSet_Avx2 )
+		failedCount += _testInstructionSet( Deinterleaver::InstructionSet_Avx2 );
+
+	if ( bestInstructionSet == Deinterleaver::InstructionSet_Scalar )
+		printf( "no vectorized kernels on this CPU, nothing to compare\n" );
+
+	return failedCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDataStream>
+#include <QStringList>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+
+#include <cstdio>
+
+#include <grim/audio/FormatManager.h>
+#include <grim/audio/FormatPlugin.h>
+
+
+
+
+// enough opens for every worker thread to race with the others many times
+static const int kOpenCount = 4000;
+static const int kThreadCount = 8;
+
+static const int kFrequency = 44100;
+static const int kSampleCount = 1000;
+static const int kReadSize = 4096;
+
+static const qint32 kAuEncodingPcm16 = 3;
+
+
+
+
+class Fixture
+{
+public:
+	QString filePath;
+	QString format;
+	int channels;
+};
+
+
+
+
+static QByteArray _samples( const int channels )
+{
+	QByteArray data( kSampleCount*channels*2, 0 );
+	for ( int i = 0; i < data.size(); ++i )
+		data[ i ] = char(i*7);
+	return data;
+}
+
+
+static bool _writeWave( const QString & filePath, const int channels )
+{
+	QFile file( filePath );
+	if ( !file.open( QIODevice::WriteOnly ) )
+		return false;
+
+	const QByteArray data = _samples( channels );
+
+	QDataStream ds( &file );
+	ds.setByteOrder( QDataStream::LittleEndian );
+
+	file.write( "RIFF", 4 );
+	ds << quint32(4 + 8 + 16 + 8 + data.size());
+	file.write( "WAVE", 4 );
+
+	file.write( "fmt ", 4 );
+	ds << quint32(16);
+	ds << quint16(1); // PCM
+	ds << quint16(channels);
+	ds << quint32(kFrequency);
+	ds << quint32(kFrequency*channels*2);
+	ds << quint16(channels*2);
+	ds << quint16(16);
+
+	file.write( "data", 4 );
+	ds << quint32(data.size());
+	file.write( data );
+
+	return ds.status() == QDataStream::Ok && file.error() == QFile::NoError;
+}
+
+
+static bool _writeAu( const QString & filePath, const int channels )
+{
+	QFile file( filePath );
+	if ( !file.open( QIODevice::WriteOnly ) )
+		return false;
+
+	const QByteArray data = _samples( channels );
+
+	QDataStream ds( &file );
+	ds.setByteOrder( QDataStream::BigEndian );
+
+	file.write( ".snd", 4 );
+	ds << qint32(24);
+	ds << qint32(data.size());
+	ds << kAuEncodingPcm16;
+	ds << qint32(kFrequency);
+	ds << qint32(channels);
+	file.write( data );
+
+	return ds.status() == QDataStream::Ok && file.error() == QFile::NoError;
+}
+
+
+
+
+// Opens fixtures round robin until kOpenCount files are opened, checking each one resolves
+// to the expected format and decodes to the expected number of bytes.
+class OpenFilesRunnable : public QRunnable
+{
+public:
+	OpenFilesRunnable( Grim::Audio::FormatManager * const formatManager, const QList<Fixture> & fixtures,
+			QAtomicInt * const nextIndex, QAtomicInt * const failedCount ) :
+		formatManager_( formatManager ), fixtures_( fixtures ), nextIndex_( nextIndex ), failedCount_( failedCount )
+	{}
+
+	void run()
+	{
+		QByteArray buffer( kReadSize, 0 );
+
+		for ( ; ; )
+		{
+			const int index = nextIndex_->fetchAndAddOrdered( 1 );
+			if ( index >= kOpenCount )
+				break;
+
+			const Fixture & fixture = fixtures_.at( index % fixtures_.count() );
+			Grim::Audio::FormatFile * const file = formatManager_->createFormatFile( fixture.filePath, QString() );
+
+			bool isOk = file && file->resolvedFormat() == fixture.format && file->channels() == fixture.channels;
+
+			if ( isOk )
+			{
+				qint64 totalBytes = 0;
+				for ( ; ; )
+				{
+					const qint64 bytes = file->device()->read( buffer.data(), buffer.size() );
+					if ( bytes <= 0 )
+					{
+						isOk = bytes == 0;
+						break;
+					}
+					totalBytes += bytes;
+				}
+				isOk = isOk && totalBytes == qint64(kSampleCount)*fixture.channels*2;
+			}
+
+			if ( !isOk )
+			{
+				failedCount_->ref();
+				printf( "FAIL opening %s as %s\n", qPrintable( fixture.filePath ), qPrintable( fixture.format ) );
+			}
+
+			delete file;
+		}
+	}
+
+private:
+	Grim::Audio::FormatManager * formatManager_;
+	QList<Fixture> fixtures_;
+	QAtomicInt * nextIndex_;
+	QAtomicInt * failedCount_;
+};
+
+
+
+
+int main()
+{
+	QTemporaryDir dir;
+	if ( !dir.isValid() )
+	{
+		printf( "cannot create temporary directory\n" );
+		return 1;
+	}
+
+	// files without extension go thru format probing instead of extension lookup
+	static const struct { const char * fileName; const char * format; int channels; } kFixtures[] = {
+		{ "mono.wav",        "Wave", 1 },
+		{ "stereo.wav",      "Wave", 2 },
+		{ "mono.au",         "Au",   1 },
+		{ "stereo.au",       "Au",   2 },
+		{ "wave-no-suffix",  "Wave", 2 },
+		{ "au-no-suffix",    "Au",   2 }
+	};
+
+	QList<Fixture> fixtures;
+	for ( size_t i = 0; i < sizeof(kFixtures)/sizeof(kFixtures[0]); ++i )
+	{
+		Fixture fixture;
+		fixture.filePath = dir.path() + QLatin1Char( '/' ) + QLatin1String( kFixtures[ i ].fileName );
+		fixture.format = QLatin1String( kFixtures[ i ].format );
+		fixture.channels = kFixtures[ i ].channels;
+
+		const bool isWritten = fixture.format == QLatin1String( "Wave" ) ?
+				_writeWave( fixture.filePath, fixture.channels ) :
+				_writeAu( fixture.filePath, fixture.channels );
+		if ( !isWritten )
+		{
+			printf( "cannot write %s\n", qPrintable( fixture.filePath ) );
+			return 1;
+		}
+
+		fixtures << fixture;
+	}
+
+	Grim::Audio::FormatManager formatManager;
+
+	QAtomicInt nextIndex( 0 );
+	QAtomicInt failedCount( 0 );
+
+	QThreadPool threadPool;
+	threadPool.setMaxThreadCount( kThreadCount );
+	for ( int i = 0; i < kThreadCount; ++i )
+		threadPool.start( new OpenFilesRunnable( &formatManager, fixtures, &nextIndex, &failedCount ) );
+	threadPool.waitForDone();
+
+	printf( "%d of %d concurrent opens resolved to expected format\n", kOpenCount - failedCount.load(), kOpenCount );
+
+	return failedCount.load() == 0 ? 0 : 1;
+}